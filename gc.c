@@ -59,6 +59,9 @@
  * /OPTIONS - specifies that the filename preceeding the option is an 
  *  option file (only 1 allowed)
  *  /QUIET - don't report multiple definitions arising from a .stb file.
+ *  /NOMMAP - read text input files with fgets() instead of mapping them.
+ *  /INDEX - build a compiled index (.LBX) for each library that needs one.
+ *  /NOINDEX - ignore compiled library indexes.
  * 
  ***********************************************************************/
 
@@ -113,6 +116,7 @@ DEFTYP(def_map, ".MAP")
 DEFTYP(def_stb, ".STB")
 DEFTYP(def_sym, ".SYM")
 DEFTYP(def_sec, ".SEC")
+DEFTYP(def_jsn, ".JSONL")
 DEFTYP(def_hex, ".HEX")
 DEFTYP(def_ln, ".LN")
 DEFTYP(def_lb, ".LB")
@@ -122,12 +126,14 @@ DEFTYP(def_ol, ".OL")
 DEFTYP(def_obj, ".OB")
 DEFTYP(def_ob, ".ob")
 DEFTYP(def_lib, ".LIB")
+DEFTYP(def_lbx, ".LBX")
 DEFTYP(def_tmp, ".")
 #else
 DEFTYP(def_map, ".map")
 DEFTYP(def_stb, ".stb")
 DEFTYP(def_sym, ".sym")
 DEFTYP(def_sec, ".sec")
+DEFTYP(def_jsn, ".jsonl")
 DEFTYP(def_hex, ".hex")
 DEFTYP(def_ln, ".ln")
 DEFTYP(def_lb, ".lb")
@@ -137,6 +143,7 @@ DEFTYP(def_ol, ".ol")
 DEFTYP(def_obj, ".ob")
 DEFTYP(def_ob, ".ob")
 DEFTYP(def_lib, ".lib")
+DEFTYP(def_lbx, ".lbx")
 DEFTYP(def_tmp, ".")
 #endif
 
@@ -163,9 +170,12 @@ DEFTYP(def_tmp, ".")
 #define map_desc	qual_tbl[QUAL_FN_MAP]
 #define sec_desc	qual_tbl[QUAL_FN_SEC]
 #define stb_desc	qual_tbl[QUAL_FN_STB]
+#define jsn_desc	qual_tbl[QUAL_FN_JSON]
 #define bin_desc	qual_tbl[QUAL_BINARY]
 #define msr_desc	qual_tbl[QUAL_MISER]
 #define quiet_desc	qual_tbl[QUAL_QUIET]
+#define mmap_desc	qual_tbl[QUAL_MMAP]
+#define index_desc	qual_tbl[QUAL_INDEX]
 
 #ifdef VMS
 	#define FILENAME_LEN 256	/* maximum length of filename in chars	*/
@@ -197,6 +207,7 @@ static struct
 	{ &stb_desc, def_stb },     /* /STB=filename */
 	{ &sym_desc, def_sym },     /* /SYMBOL=filename */
 	{ &sec_desc, def_sec },     /* /SECTION=filename */
+	{ &jsn_desc, def_jsn },     /* /JSON=filename */
 	{ &tmp_desc, def_tmp }      /* /TEMPFILE=directory */
 };
 
@@ -231,30 +242,29 @@ void get_fn_pool(void)
 	if ( fn_pool_size < 2 * FILENAME_LEN )
 	{ /* to save CPU time, the free pool */
 		fn_pool_size = 1024;      /* a bunch of memory */
-		fn_pool = (char *)MEM_alloc(fn_pool_size); /* the size required. It is assumed */
+		fn_pool = (char *)MEM_pool(fn_pool_size); /* the size required. It is assumed */
 		fn_pool_used += fn_pool_size;
 	}                    /* that most filenames will be short */
 	return;
 }
 
-static struct fn_struct **xref_pool = 0;  /* pointer to xref pool */
+static char *xref_pool = 0;  /* pointer to xref pool */
 static int xref_pool_size = 0;        /* size of xref free pool */
 
-struct fn_struct** get_xref_pool(void)
+char *get_xref_pool(int size)
 {
-	struct fn_struct **fn_ptr;
-	if ( xref_pool_size < XREF_BLOCK_SIZE )
+	char *ptr;
+	size = (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+	if ( xref_pool_size < size )
 	{
-		int t;
-		xref_pool_size = XREF_BLOCK_SIZE * 256 / sizeof(struct fn_struct **);
-		t = xref_pool_size * sizeof(struct fn_struct **);
-		xref_pool = (struct fn_struct **)MEM_alloc(t);
-		xref_pool_used += t;
+		xref_pool_size = 4096;
+		xref_pool = MEM_pool(xref_pool_size);
+		xref_pool_used += xref_pool_size;
 	}
-	xref_pool_size -= XREF_BLOCK_SIZE;   /* dish them out n at a time */
-	fn_ptr = xref_pool;
-	xref_pool += XREF_BLOCK_SIZE;
-	return (fn_ptr);
+	xref_pool_size -= size;   /* dish them out as asked */
+	ptr = xref_pool;
+	xref_pool += size;
+	return (ptr);
 }
 
 int fn_init(FN_struct *pointer)
@@ -292,7 +302,7 @@ FN_struct* get_fn_struct(void)
 	{   /* get some memory to hold the structs */
 		int t = 128;
 		fn_struct_pool =
-			(struct fn_struct *)MEM_alloc(t * sizeof(struct fn_struct));
+			(struct fn_struct *)MEM_pool(t * sizeof(struct fn_struct));
 		fn_struct_poolsize = t;
 		fn_pool_used += t * sizeof(struct fn_struct);
 	}
@@ -388,7 +398,7 @@ static char* do_option(char *str)
 								char *end;
 								end = NULL;
 								qual_tbl[lc].valueInt = strtol(cp, &end, 0);
-								if ( !end || !isspace(*end) )
+								if ( !end || (*end && !isspace(*end)) )
 								{
 									sprintf(emsg, "Value {%s} on {%c%s} must be number.",
 											beg, OPT_DELIM, loc);
@@ -111,7 +111,7 @@ void insert_intogroup(
     if (grp_ptr->grp_free <= 2)
     {
         int t = 32*sizeof(struct ss_struct **);
-        sp = (SS_struct **)MEM_alloc(t);
+        sp = (SS_struct **)MEM_pool(t);
         grp_pool_used += t;
         if (grp_ptr->grp_free)
         {
@@ -161,7 +161,7 @@ GRP_struct *get_grp_ptr(
         if (group_list_free <= 1)
         {
             int t = 10*sizeof(struct grp_struct);
-            grp_ptr = (struct grp_struct *)MEM_alloc(t);
+            grp_ptr = (struct grp_struct *)MEM_pool(t);
             grp_pool_used += t;
             group_list_next->grp_top = (struct ss_struct **)-1l;
             group_list_next->grp_next = (struct ss_struct **)grp_ptr;
@@ -16,6 +16,8 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <inttypes.h>
+
 /**********************************************************
  *
  * int hashit(input_string,hash_table_size)
@@ -40,3 +42,32 @@ unsigned int hashit( char *strng, int hash_size )
     }
     return hashv % hash_size;
 }
+
+/**********************************************************
+ *
+ * uint32_t hashit32(input_string,length_ptr)
+ * char *input_string
+ * int32_t *length_ptr
+ * 
+ * Hashes the input string to a full 32 bit value (FNV-1a) suitable
+ * for masking to a power of 2 table size. The string must be null
+ * terminated. The length of the string (not counting the null) is
+ * returned in *length_ptr.
+ *
+ *******************************************************************/
+
+uint32_t hashit32( const char *strng, int32_t *lenp )
+{
+    uint32_t hashv;
+    const unsigned char *s;
+    unsigned char c;
+    hashv = 2166136261u;
+    s = (const unsigned char *)strng;
+    while ((c= *s++) != 0)
+    {
+        hashv ^= c;
+        hashv *= 16777619u;
+    }
+    *lenp = (int32_t)(s - (const unsigned char *)strng) - 1;
+    return hashv;
+}
@@ -41,8 +41,7 @@ extern char *inp_str;		/* temp string area */
 
 #include "memmgt.h"
 
-extern int32_t id_table_size;	/* size of ID number table */
-extern int32_t id_table_base;	/* offset for ID number table */
+extern int32_t id_table_size;	/* most ID table entries in use at once */
 extern int32_t grp_pool_used;	/* amount of memory used for grps */
 extern int16_t new_ident;		/* new identifier assignment */
 
@@ -54,6 +53,7 @@ extern int error_count[5];
 extern char *commandLine;
 
 extern char *def_lib_ptr[];
+extern char def_lbx[];
 extern char *def_obj_ptr[];
 extern int info_enable;
 extern int32_t token_value;    /* value of current token */
@@ -69,6 +69,7 @@ extern void add_to_reserve(uint32_t start, uint32_t len);
 extern int check_reserve(uint32_t start, uint32_t len);
 extern int get_free_space(uint32_t len, uint32_t *start, int align);
 extern unsigned int hashit( char *strng, int hash_size );
+extern uint32_t hashit32( const char *strng, int32_t *lenp );
 extern void sym_stats( void );
 
 extern FILE *outxsym_fp;	/* global pointer for outx routines */
@@ -83,6 +84,7 @@ extern char def_map[],
 def_stb[],
 def_sym[],
 def_sec[],
+def_jsn[],
 def_hex[],
 def_ln[],
 def_lb[],
@@ -99,6 +101,7 @@ extern int32_t grp_pool_used;
 extern int32_t rm_pool_used;
 extern int32_t misc_pool_used;
 extern int32_t tmp_pool_used;
+extern int32_t tmp_spill_used;
 extern int32_t sym_pool_used;
 extern int32_t symdef_pool_used;
 extern int32_t total_mem_used;
@@ -45,6 +45,7 @@ static char *help_msg[] = {
 #endif
     OPT,"[no]symbol","[=name] - select and name symbol file\n",
     OPT,"[no]stb","[=name]	- select and name symbol table file\n",
+    OPT,"[no]json","[=name]	- select and name JSON Lines map file\n",
     OPT,"option","[=name]	- names an input option file\n",
     OPT,"library","[=name]	- names an input library file\n",
     OPT,"[no]binary","	- select binary format output file\n",
@@ -55,11 +56,19 @@ static char *help_msg[] = {
     OPT,"[no]relative","	- select relative output file format\n",
     OPT,"[no]error","	- force display of undefined symbols in ",OPT,"relative"," mode\n",
 	OPT,"[no]quiet","	- Suppress multiple symbol define warnings arising from a .stb file mode\n",
+    OPT,"[no]mmap","	- read text input files through memory mapping\n",
+    OPT,"[no]index","	- build compiled library indexes (",OPT,"noindex ignores them)\n",
+    OPT,"memlimit","=n	- spill pass 2 work data to disk past n Kbytes of memory\n",
+    OPT,"[no]pack","	- compress pass 2 work data held in memory\n",
+    OPT,"[no]image","	- build the whole image in memory, then write it in address order\n",
+    OPT,"bufsize","=n	- write output files through n Kbyte buffers (default 256)\n",
+    OPT,"[no]async","	- write map, sym, sec and stb files from background threads\n",
+    OPT,"threads","=n	- share formatting work among n threads (1 = none)\n",
     "Options may be abbreviated to 1 or more characters.\n",
     "Defaults are ",OPT,"out ",OPT,"nomap ",OPT,"notemp ",OPT,"nosym ",
     OPT,"nostb ",OPT,"nobin ",OPT,"nocross\n",
     "             ",OPT,"nooctal ",OPT,"noobj ",OPT,"norel ",
-    OPT,"noerr ",OPT,"noopt ",OPT,"nolib ",OPT,"noquiet\n",
+    OPT,"noerr ",OPT,"noopt ",OPT,"nolib ",OPT,"noquiet ",OPT,"mmap\n",
     "And the output filename defaults to the same name as the first input\n",
     "file with file types according to the following:\n",
     "  ",UPC,def_vlda," if ",OPT,"bin ",OPT,"norel, ",UPC,def_lb," if ",OPT,"bin ",OPT,"rel,\n",
@@ -0,0 +1,211 @@
+/*
+    image.c - Part of llf, a cross linker. Part of the macxx tool chain.
+    Copyright (C) 2008 David Shepperd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>		/* get standard I/O definitions */
+#include <string.h>
+#include "token.h"		/* define compile time constants */
+#include "structs.h"		/* define structures */
+#include "header.h"
+
+/*
+ * Sparse memory image for -IMAGE.
+ *
+ * With -IMAGE, pass2 stores the absolute output here instead of
+ * writing it as it goes, and outx writes it all out at the end in
+ * address order. The 32 bit address space is split into pages of
+ * IMG_PAGE bytes found through a two level directory, each level
+ * indexed by IMG_DIR_BITS of the page number. Pages and second level
+ * tables are only allocated when something is stored in them. Each
+ * page has a bitmap of the bytes that have been stored, so holes are
+ * left out of the output and any byte stored twice is reported.
+ */
+
+#define IMG_PAGE_BITS	12
+#define IMG_PAGE	(1 << IMG_PAGE_BITS)
+#define IMG_DIR_BITS	10
+#define IMG_DIR		(1 << IMG_DIR_BITS)
+
+typedef struct img_page
+{
+	uint8_t ip_data[IMG_PAGE];	/* the bytes */
+	uint8_t ip_used[IMG_PAGE / 8]; /* bit set for each byte stored */
+} ImgPage_t;
+
+static ImgPage_t **img_dir[IMG_DIR];
+static uint32_t ovl_start, ovl_end; /* overlap being collected */
+
+static void ovl_report(void)
+{
+	if ( ovl_end == ovl_start )
+		return;
+	if ( qual_tbl[QUAL_OCTAL].present )
+		sprintf(emsg, "Output written more than once at %011o-%011o",
+				ovl_start, ovl_end - 1);
+	else
+		sprintf(emsg, "Output written more than once at %08X-%08X",
+				ovl_start, ovl_end - 1);
+	err_msg(MSG_WARN, emsg);
+	ovl_start = ovl_end = 0;
+}
+
+static void ovl_note(uint32_t addr)
+{
+	if ( ovl_end != ovl_start && addr == ovl_end )
+	{
+		++ovl_end;
+		return;
+	}
+	ovl_report();
+	ovl_start = addr;
+	ovl_end = addr + 1;
+}
+
+/********************************************************************
+ * Store bytes in the image
+ */
+void image_put(uint32_t addr, const uint8_t *from, int len)
+/*
+ * At entry:
+ *	addr - address of first byte
+ *	from - pointer to bytes
+ *	len - number of bytes
+ * At exit:
+ *	bytes stored. Any that had already been stored are noted for
+ *	a warning.
+ */
+{
+	ImgPage_t **tbl, *pg;
+	uint32_t pnum;
+	int off, cnt, ii;
+
+	while ( len > 0 )
+	{
+		pnum = addr >> IMG_PAGE_BITS;
+		off = addr & (IMG_PAGE - 1);
+		cnt = IMG_PAGE - off;
+		if ( cnt > len )
+			cnt = len;
+		if ( (tbl = img_dir[pnum >> IMG_DIR_BITS]) == 0 )
+		{
+			tbl = (ImgPage_t **)MEM_alloc(IMG_DIR * sizeof(ImgPage_t *));
+			misc_pool_used += IMG_DIR * sizeof(ImgPage_t *);
+			img_dir[pnum >> IMG_DIR_BITS] = tbl;
+		}
+		if ( (pg = tbl[pnum & (IMG_DIR - 1)]) == 0 )
+		{
+			pg = (ImgPage_t *)MEM_alloc(sizeof(ImgPage_t));
+			misc_pool_used += sizeof(ImgPage_t);
+			tbl[pnum & (IMG_DIR - 1)] = pg;
+		}
+		memcpy(pg->ip_data + off, from, cnt);
+		for (ii = off; ii < off + cnt; ++ii)
+		{
+			if ( pg->ip_used[ii >> 3] & (1 << (ii & 7)) )
+				ovl_note((pnum << IMG_PAGE_BITS) + ii);
+			pg->ip_used[ii >> 3] |= 1 << (ii & 7);
+		}
+		addr += cnt;
+		from += cnt;
+		len -= cnt;
+	}
+}
+
+/********************************************************************
+ * Find the next run of stored bytes
+ */
+const uint8_t *image_run(uint32_t *addr, int *len)
+/*
+ * At entry:
+ *	addr - pointer to address to start looking at
+ *	len - pointer to place to put run length
+ * At exit:
+ *	returns pointer to the bytes of the next run at or after *addr
+ *	with *addr set to its address and *len to its length, or 0 if
+ *	there are no more. A run stops at the end of a page; the next
+ *	one picks up at the start of the following page.
+ */
+{
+	ImgPage_t **tbl, *pg;
+	uint32_t pnum;
+	int off, end;
+
+	pnum = *addr >> IMG_PAGE_BITS;
+	off = *addr & (IMG_PAGE - 1);
+	for (;;)
+	{
+		if ( (tbl = img_dir[pnum >> IMG_DIR_BITS]) == 0 )
+		{
+			pnum = (pnum | (IMG_DIR - 1)) + 1;   /* skip the whole table */
+			off = 0;
+		}
+		else if ( (pg = tbl[pnum & (IMG_DIR - 1)]) == 0 )
+		{
+			++pnum;
+			off = 0;
+		}
+		else
+		{
+			while ( off < IMG_PAGE )
+			{
+				if ( pg->ip_used[off >> 3] == 0 && !(off & 7) )
+				{
+					off += 8;
+					continue;
+				}
+				if ( pg->ip_used[off >> 3] & (1 << (off & 7)) )
+					break;
+				++off;
+			}
+			if ( off < IMG_PAGE )
+			{
+				for (end = off + 1; end < IMG_PAGE
+					 && (pg->ip_used[end >> 3] & (1 << (end & 7))); ++end)
+					;
+				*addr = (pnum << IMG_PAGE_BITS) + off;
+				*len = end - off;
+				return pg->ip_data + off;
+			}
+			++pnum;
+			off = 0;
+		}
+		if ( pnum >= ((uint32_t)1 << (32 - IMG_PAGE_BITS)) )
+			return 0;
+	}
+}
+
+/********************************************************************
+ * Give back the image
+ */
+void image_free(void)
+{
+	int ii, jj;
+
+	ovl_report();
+	for (ii = 0; ii < IMG_DIR; ++ii)
+	{
+		if ( img_dir[ii] == 0 )
+			continue;
+		for (jj = 0; jj < IMG_DIR; ++jj)
+		{
+			if ( img_dir[ii][jj] )
+				MEM_free(img_dir[ii][jj]);
+		}
+		MEM_free(img_dir[ii]);
+		img_dir[ii] = 0;
+	}
+}
@@ -29,51 +29,93 @@
  *
  * This routine inserts into the ID table at the offset spec'd by
  * the first argument the symbol block pointer passed as the
- * second argument. It will increase the size of the ID table
- * if required.
+ * second argument.
  *
- * Routine returns void. To retrieve an ID from the table,
- * use *(id_table[id_table_base+desired_id])
+ * The ID table is kept in pages of ID_PAGE_SIZE entries which are
+ * allocated as they are needed and never move. Only the small page
+ * directory is ever reallocated. To retrieve an ID from the table,
+ * use get_id(desired_id).
  ***************************************************************/
 
+#define ID_PAGE_BITS 10
+#define ID_PAGE_SIZE (1<<ID_PAGE_BITS)
+
 /* Global static variables */
 
-struct ss_struct **id_table = 0; /* pointer to identifier table */
-int32_t id_table_size=0;       /* size of id_table in int's */
-int32_t id_table_base=0;       /* base for the current file */
+static SS_struct ***id_dir;     /* directory of ID pages */
+static int32_t id_dir_size;     /* number of entries in id_dir */
+static int32_t id_slots;        /* number of ID's in allocated pages */
+int32_t id_table_size=0;       /* most ID's allocated at once */
 int32_t tot_ids,max_idu;
 
+/***************************************************************
+ * Get a pointer to an ID's entry in the table
+ ***************************************************************/
+
+static SS_struct **id_slot( int32_t id )
+{
+    uint32_t page;
+    SS_struct **pp;
+
+    page = (uint32_t)id >> ID_PAGE_BITS;
+    if (page >= (uint32_t)id_dir_size)
+    {
+        int32_t old_sz,kk;
+        old_sz = id_dir_size;
+        kk = old_sz ? old_sz : 32;
+        while ((uint32_t)kk <= page) kk *= 2;
+        if (id_dir == 0)
+            id_dir = (SS_struct ***)MEM_alloc(kk*sizeof(SS_struct **));
+        else
+            id_dir = (SS_struct ***)MEM_realloc((char *)id_dir,kk*sizeof(SS_struct **));
+        misc_pool_used += (kk-old_sz)*sizeof(SS_struct **);
+        while (old_sz < kk) id_dir[old_sz++] = 0;
+        id_dir_size = kk;
+    }
+    if ((pp = id_dir[page]) == 0)
+    {
+        id_dir[page] = pp = (SS_struct **)MEM_calloc(ID_PAGE_SIZE,sizeof(SS_struct *));
+        id_slots += ID_PAGE_SIZE;
+        if (id_slots > id_table_size) id_table_size = id_slots;
+    }
+    return pp+(id & (ID_PAGE_SIZE-1));
+}
+
+/***************************************************************
+ * Look up an ID. Returns 0 if it hasn't been set.
+ ***************************************************************/
+
+SS_struct *get_id( int32_t id )
+{
+    uint32_t page;
+    SS_struct **pp;
+
+    page = (uint32_t)id >> ID_PAGE_BITS;
+    if (page >= (uint32_t)id_dir_size || (pp = id_dir[page]) == 0) return 0;
+    return pp[id & (ID_PAGE_SIZE-1)];
+}
+
+/***************************************************************
+ * Set an ID without any checks
+ ***************************************************************/
+
+void set_id( int32_t id, SS_struct *id_ptr )
+{
+    *id_slot(id) = id_ptr;
+    if (id > max_idu)
+		max_idu = id;
+    return;
+}
+
 /* Entry */
 
 void insert_id( int32_t id, SS_struct *id_ptr)
 {
     struct ss_struct **st,*sp;   /* st is pointer to pointer to ss_struct */
-    int32_t idx,kk;
 	
-	idx = id+id_table_base;
-    if (idx >= id_table_size)
-    {
-        kk = (idx/1024+1)*1024;
-        if (id_table == 0)
-        {  /* first time, build an array */
-            if (kk < 28672/sizeof(char *))
-				kk = 28672/sizeof(char *);
-			id_table_size = kk;
-            id_table = (SS_struct **)MEM_calloc(id_table_size, sizeof(SS_struct **));
-        }
-        else
-        {
-            int old_sz;
-            old_sz = id_table_size;
-			id_table_size = kk;
-            id_table = (SS_struct **)MEM_realloc((char *)id_table, id_table_size*sizeof(SS_struct **));
-            while (old_sz<id_table_size)
-				id_table[old_sz++] = NULL;
-        }
-    }
-    if (idx > max_idu)
-		max_idu = idx;
-	st = id_table+idx;
+	st = id_slot(id);
+    if (id > max_idu)
+		max_idu = id;
 	sp = *st;
     if ( sp )
     {
@@ -89,3 +131,26 @@ void insert_id( int32_t id, SS_struct *id_ptr)
     *st = id_ptr;
     return;
 }
+
+/***************************************************************
+ * Let go of the current file's ID's. By the end of a file all the
+ * expressions that used them have been bound to their symbols
+ * (see bind_ids()) so the pages are given back and the next file
+ * starts with an empty table.
+ ***************************************************************/
+
+void release_ids( void )
+{
+    int32_t ii;
+
+    for (ii=0; ii < id_dir_size; ++ii)
+    {
+        if (id_dir[ii] != 0)
+        {
+            MEM_free((char *)id_dir[ii]);
+            id_dir[ii] = 0;
+            id_slots -= ID_PAGE_SIZE;
+        }
+    }
+    return;
+}
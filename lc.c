@@ -717,8 +717,7 @@ int lc_locate( char **opt )
                     *(token_pool+token_value) = ' ';
                     ++token_value;
                     *(token_pool+token_value) = 0;
-                    grp_nam->ss_string = token_pool; /* point to name */
-                    token_pool += token_value+1; /* keep the name */
+                    grp_nam->ss_string = name_intern(token_pool,1)->nm_string; /* point to name */
                 }
                 state = LOCATE_SEG_TO;      /* look for base, TO, OUTPUT or NAME */
                 continue;
@@ -732,17 +731,11 @@ int lc_locate( char **opt )
                 ++token_value;
                 *(token_pool+token_value) = 0;
                 sym = sym_lookup(token_pool, ++token_value, 2);
-                if (new_symbol == 5)
-                {   /* symbol added and is a duplicate */
-                    sym->ss_string = first_symbol->ss_string;
-                }
-                else if (new_symbol == 1 || new_symbol == 3)
+                if (new_symbol == 1 || new_symbol == 3)
                 { /* added or added and first in hash */
                     sym->ss_fnd = 0;  /* actually pointed to by ourself */
-                    token_pool += token_value;
-                    token_pool_size -= token_value;
                 }
-                else
+                else if (new_symbol != 5)   /* 5 = added and is a duplicate */
                 {
                     bad_token(tkn_ptr, "Unable to create new section");
                     ++err;
@@ -0,0 +1,544 @@
+/*
+    libidx.c - Part of llf, a cross linker. Part of the macxx tool chain.
+    Copyright (C) 2008 David Shepperd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/********************************************************************
+ *
+ * This module manages compiled library indexes. A text library lists
+ * object files, each followed by tab indented lines naming the symbols
+ * it defines, and library() has to read all of it on every visit. A
+ * compiled index (same name and directory as the library with a file
+ * type of .lbx) holds the same information in a form that is mapped
+ * and queried directly with the names of the undefined symbols:
+ *
+ *	LBX_header	magic, version, size, modification and status
+ *			change times (with nanoseconds) of the library it
+ *			was built from and the sizes of the other parts.
+ *	LBX_member[]	one per object file, offsets to its name and date.
+ *	LBX_slot[]	open addressed hash table (power of 2 in size,
+ *			linear probing) of symbol name to member. The hash
+ *			is hashit32(), the same one kept with each interned
+ *			name, so a query never has to hash a string.
+ *	strings		null terminated names and dates. Offset 0 is an
+ *			empty string and means "none".
+ *
+ * All values are native endian uint32_t's. An index is only used if
+ * the size and both times of its library still match, and the library
+ * was last changed before the index was written. A library changed in
+ * the same clock tick as its index was written (or later, with a clock
+ * that is off) may have been changed again without its times moving,
+ * so that index is not trusted and the library's text is read instead.
+ * With -INDEX an index is (re)built for any library that has none or
+ * has a stale one. With -NOINDEX indexes are ignored.
+ *
+ *******************************************************************/
+
+#if defined(M_UNIX) && !defined(_POSIX_C_SOURCE)
+    #define _POSIX_C_SOURCE 200809L	/* for open() and friends and st_mtim */
+#endif
+#include <stdio.h>		/* get standard I/O definitions */
+#include <ctype.h>		/* get standard string type macros */
+#include <string.h>
+#include <errno.h>
+#if defined(M_UNIX)
+    #include <sys/types.h>
+    #include <sys/stat.h>
+    #include <sys/mman.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+#include "token.h"		/* define compile time constants */
+#include "structs.h"		/* define structures */
+#include "header.h"		/* get our standard stuff */
+#include "add_defs.h"
+
+#define LBX_MAGIC	"LBX1"
+#define LBX_VERSION	2
+#define LBX_STAMP	8	/* uint32_t's in lbx_stamp */
+
+typedef struct lbx_header {
+   char lbx_magic[4];		/* LBX_MAGIC */
+   uint32_t lbx_version;	/* LBX_VERSION */
+   uint32_t lbx_stamp[LBX_STAMP]; /* size, mtime and ctime of the library (see lbx_stamp()) */
+   uint32_t lbx_members;	/* number of LBX_member's */
+   uint32_t lbx_symbols;	/* number of symbols in the hash table */
+   uint32_t lbx_hashsize;	/* number of LBX_slot's (power of 2) */
+   uint32_t lbx_strsize;	/* number of bytes of strings */
+} LBX_header;
+
+typedef struct lbx_member {
+   uint32_t lm_name;		/* offset to filename */
+   uint32_t lm_date;		/* offset to date (0 if none) */
+} LBX_member;
+
+typedef struct lbx_slot {
+   uint32_t ls_hash;		/* hashit32() of the name */
+   uint32_t ls_name;		/* offset to the name (0 if slot empty) */
+   uint32_t ls_member;		/* index of member defining it */
+} LBX_slot;
+
+static LBX_header *lbx_hdr;	/* mapped index (0 if none) */
+static size_t lbx_map_size;	/* size of mapping */
+static LBX_member *lbx_members;	/* pointer to member table */
+static LBX_slot *lbx_slots;	/* pointer to hash table */
+static char *lbx_strings;	/* pointer to string area */
+
+static char *lbx_str;		/* strings being built */
+static uint32_t lbx_str_used;	/* bytes in use in lbx_str */
+static uint32_t lbx_str_size;	/* size of lbx_str */
+
+#if defined(M_UNIX)
+/*******************************************************************
+ * Describe a library by its size and times
+ */
+static void lbx_stamp( const struct stat *st, uint32_t *stamp )
+/*
+ * At entry:
+ *	st - the library's stat
+ *	stamp - where to put LBX_STAMP values
+ * At exit:
+ *	stamp holds the size (low and high 32 bits), then the seconds
+ *	(low, high) and nanoseconds of the modification time and of the
+ *	status change time.
+ */
+{
+    uint64_t v;
+    v = (uint64_t)st->st_size;
+    stamp[0] = (uint32_t)v;
+    stamp[1] = (uint32_t)(v>>32);
+    v = (uint64_t)st->st_mtim.tv_sec;
+    stamp[2] = (uint32_t)v;
+    stamp[3] = (uint32_t)(v>>32);
+    stamp[4] = (uint32_t)st->st_mtim.tv_nsec;
+    v = (uint64_t)st->st_ctim.tv_sec;
+    stamp[5] = (uint32_t)v;
+    stamp[6] = (uint32_t)(v>>32);
+    stamp[7] = (uint32_t)st->st_ctim.tv_nsec;
+}
+#endif
+
+/*******************************************************************
+ * Make the name of a library's index file
+ */
+static char *lbx_name( FN_struct *fnd )
+/*
+ * At entry:
+ *	fnd - pointer to library file descriptor
+ * At exit:
+ *	returns pointer to MEM_alloc'd index filename
+ */
+{
+    char *name;
+    int len;
+    len = strlen(fnd->fn_buff);
+    if (fnd->fn_nam != 0 && fnd->fn_nam->type_only != 0)
+        len -= strlen(fnd->fn_nam->type_only);
+    name = MEM_alloc(len+strlen(def_lbx)+1);
+    memcpy(name,fnd->fn_buff,len);
+    strcpy(name+len,def_lbx);
+    return(name);
+}
+
+/*******************************************************************
+ * Open the compiled index of a library
+ */
+int libidx_open( FN_struct *fnd )
+/*
+ * At entry:
+ *	fnd - pointer to file descriptor of an opened library
+ * At exit:
+ *	returns TRUE if the library's index has been mapped and
+ *	libidx_library() can be used instead of library(), else FALSE.
+ */
+{
+#if defined(M_UNIX)
+    struct stat lst,st;
+    LBX_header *hp;
+    uint32_t stamp[LBX_STAMP];
+    char *name;
+    void *mp;
+    size_t need;
+    int fd;
+    if (qual_tbl[QUAL_INDEX].negated) return(FALSE);
+    if (fstat(fileno(fnd->fn_file),&lst) != 0) return(FALSE);
+    name = lbx_name(fnd);
+    fd = open(name,O_RDONLY);
+    if (fd < 0)
+    {
+        MEM_free(name);
+        return(FALSE);
+    }
+    if (fstat(fd,&st) != 0 || st.st_size < (off_t)sizeof(LBX_header) ||
+        (off_t)(size_t)st.st_size != st.st_size)
+    {
+        close(fd);
+        MEM_free(name);
+        return(FALSE);
+    }
+    mp = mmap(0,(size_t)st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+    close(fd);
+    if (mp == MAP_FAILED)
+    {
+        MEM_free(name);
+        return(FALSE);
+    }
+    hp = (LBX_header *)mp;
+    need = 0;
+    if (memcmp(hp->lbx_magic,LBX_MAGIC,4) == 0 && hp->lbx_version != LBX_VERSION)
+    {
+        if (debug)
+            printf("Library index %s is from another version of llf\n",name);
+        munmap(mp,(size_t)st.st_size);
+        MEM_free(name);
+        return(FALSE);
+    }
+    if (memcmp(hp->lbx_magic,LBX_MAGIC,4) == 0 &&
+        hp->lbx_hashsize != 0 &&
+        (hp->lbx_hashsize&(hp->lbx_hashsize-1)) == 0 &&
+        hp->lbx_symbols < hp->lbx_hashsize &&
+        hp->lbx_strsize != 0 &&
+        hp->lbx_members < (size_t)st.st_size/sizeof(LBX_member) &&
+        hp->lbx_hashsize < (size_t)st.st_size/sizeof(LBX_slot))
+    {
+        need = sizeof(LBX_header)+hp->lbx_members*sizeof(LBX_member)+
+               hp->lbx_hashsize*sizeof(LBX_slot)+hp->lbx_strsize;
+    }
+    if (need != (size_t)st.st_size ||
+        ((char *)mp)[need-1] != 0)
+    {
+        sprintf(emsg,"Library index \"%s\" is not valid, ignored",name);
+        err_msg(MSG_WARN,emsg);
+        munmap(mp,(size_t)st.st_size);
+        MEM_free(name);
+        return(FALSE);
+    }
+    lbx_stamp(&lst,stamp);
+    if (memcmp((char *)hp->lbx_stamp,(char *)stamp,sizeof(stamp)) != 0)
+    {
+        if (debug)
+            printf("Library index %s is out of date\n",name);
+        munmap(mp,(size_t)st.st_size);
+        MEM_free(name);
+        return(FALSE);
+    }
+    if (lst.st_mtim.tv_sec > st.st_mtim.tv_sec ||
+        (lst.st_mtim.tv_sec == st.st_mtim.tv_sec && lst.st_mtim.tv_nsec >= st.st_mtim.tv_nsec))
+    {   /* library changed in the tick its index was written, can't tell */
+        if (debug)
+            printf("Library index %s may be out of date, not used\n",name);
+        munmap(mp,(size_t)st.st_size);
+        MEM_free(name);
+        return(FALSE);
+    }
+    lbx_hdr = hp;
+    lbx_map_size = (size_t)st.st_size;
+    lbx_members = (LBX_member *)(hp+1);
+    lbx_slots = (LBX_slot *)(lbx_members+hp->lbx_members);
+    lbx_strings = (char *)(lbx_slots+hp->lbx_hashsize);
+    if (debug > 1)
+        printf("Mapped %lu bytes of library index %s\n",(unsigned long)lbx_map_size,name);
+    MEM_free(name);
+    return(TRUE);
+#else
+    return(FALSE);
+#endif
+}
+
+/*******************************************************************
+ * Close the compiled index
+ */
+void libidx_close( void )
+/*
+ * At entry:
+ *	no requirements
+ * At exit:
+ *	mapping (if any) is removed
+ */
+{
+#if defined(M_UNIX)
+    if (lbx_hdr != 0)
+    {
+        munmap((void *)lbx_hdr,lbx_map_size);
+        lbx_hdr = 0;
+        lbx_members = 0;
+        lbx_slots = 0;
+        lbx_strings = 0;
+    }
+#endif
+    return;
+}
+
+/*******************************************************************
+ * Library processor using the compiled index. Same results as
+ * library() but driven by the undefined symbol worklist rather than
+ * by the contents of the library.
+ */
+FN_struct *libidx_library( void )
+/*
+ * At entry:
+ * 	libidx_open() has returned TRUE for current_fnd.
+ * At exit:
+ *	additional files may have been inserted into the input
+ *	file stream in the order they appear in the library.
+ *	returns pointer to last file inserted (current_fnd if none)
+ *	or 0 if there were errors.
+ */
+{
+    FN_struct *fnd,*old_fnd=current_fnd;
+    Name_t **undefs;
+    LBX_slot *ls;
+    LBX_member *lm;
+    SS_struct *sym_ptr;
+    Name_t *nm;
+    char *need,*s;
+    uint32_t ii,jj,mask,nmem,nundef;
+    int len,erc,errcnt=0;
+
+    if ((nmem = lbx_hdr->lbx_members) == 0) return(old_fnd);
+    need = MEM_alloc(nmem);
+    mask = lbx_hdr->lbx_hashsize-1;
+    undefs = sym_undefined(&nundef);
+    for (ii=0; ii < nundef; ++ii)
+    {
+        nm = undefs[ii];            /* all are undefined and unclaimed */
+        sym_ptr = nm->nm_sym;
+        for (jj=nm->nm_hash&mask;;jj=(jj+1)&mask)
+        {
+            ls = lbx_slots+jj;
+            if (ls->ls_name == 0) break;    /* not in this library */
+            if (ls->ls_hash != nm->nm_hash) continue;
+            if (ls->ls_name >= lbx_hdr->lbx_strsize ||
+                ls->ls_member >= nmem) break;   /* bad index, treat as not there */
+            if (strcmp(lbx_strings+ls->ls_name,nm->nm_string) != 0) continue;
+            if (debug > 2)
+            {
+                printf ("\tSymbol: {%s} gets file %s\n",
+                        nm->nm_string,lbx_strings+lbx_members[ls->ls_member].lm_name);
+            }
+            need[ls->ls_member] = 1;
+            sym_ptr->flg_libr = 1;      /* got a file */
+            break;
+        }
+    }
+    for (ii=0,lm=lbx_members; ii < nmem; ++ii,++lm)
+    {
+        if (!need[ii]) continue;
+        fnd = get_fn_struct();      /* get a fn struct */
+        s = lbx_strings+(lm->lm_name < lbx_hdr->lbx_strsize ? lm->lm_name : 0);
+        len = strlen(s)+1;
+        memcpy(fn_pool,s,len);      /* fnd->fn_buff == fn_pool */
+        fnd->r_length = len;
+#ifdef VMS
+        fnd->d_length = len + 1;
+#endif
+        if (lm->lm_date != 0 && lm->lm_date < lbx_hdr->lbx_strsize)
+        {
+            s = lbx_strings+lm->lm_date;
+            fnd->fn_credate = fn_pool+len;
+            memcpy(fn_pool+len,s,strlen(s)+1);
+            len += strlen(s)+1;
+        }
+        fn_pool += len;         /* keep the string(s) */
+        fn_pool_size -= len;        /* take from total */
+        erc = add_defs(fnd->fn_buff,def_obj_ptr,(char **)0,0,&fnd->fn_nam);
+        errcnt += erc;
+        if (erc == 0)
+        {
+            fnd->fn_buff = fnd->fn_nam->full_name;
+            fnd->fn_name_only = fnd->fn_nam->name_only;
+        }
+        else
+        {
+            sprintf(emsg,"Unable to parse filename \"%s\" (from lib): %s",
+                    fnd->fn_buff,err2str(errno));
+            err_msg(MSG_WARN,emsg);
+        }
+        fnd->fn_present = 1;
+        fnd->fn_nosym = current_fnd->fn_nosym;
+        fnd->fn_nostb = current_fnd->fn_nostb;
+        fnd->fn_next = old_fnd->fn_next;
+        old_fnd->fn_next = fnd;
+        old_fnd = fnd;
+    }
+    MEM_free(need);
+    if (errcnt != 0) return(0);
+    return(old_fnd);
+}
+
+#if defined(M_UNIX)
+/*******************************************************************
+ * Add a string to the string area being built
+ */
+static uint32_t lbx_string( const char *strng, int len )
+/*
+ * At entry:
+ *	strng - pointer to string (need not be null terminated)
+ *	len - length of string not counting any null
+ * At exit:
+ *	returns offset of the null terminated copy in lbx_str
+ */
+{
+    uint32_t off;
+    if (lbx_str_used+len+1 > lbx_str_size)
+    {
+        while (lbx_str_used+len+1 > lbx_str_size) lbx_str_size += lbx_str_size/2;
+        lbx_str = MEM_realloc(lbx_str,lbx_str_size);
+    }
+    off = lbx_str_used;
+    memcpy(lbx_str+off,strng,len);
+    lbx_str[off+len] = 0;
+    lbx_str_used += len+1;
+    return(off);
+}
+#endif
+
+/*******************************************************************
+ * Build the compiled index of a library
+ */
+int libidx_build( FN_struct *fnd )
+/*
+ * At entry:
+ *	fnd - pointer to file descriptor of an opened library. It must
+ *	be current_fnd.
+ * At exit:
+ *	the library has been read and its index written. The library
+ *	file is rewound. Returns TRUE if the index was written.
+ */
+{
+#if defined(M_UNIX)
+    struct stat lst;
+    LBX_header hdr;
+    LBX_member *members;
+    LBX_slot *syms,*slots,*ls,*ns;
+    uint32_t nmem=0,msize=64,nsym=0,ssize=1024,hsize,mask,ii,jj,kk;
+    int32_t len;
+    char c,*s,*t,*name;
+    FILE *fp;
+    int ok;
+
+    if (fstat(fileno(fnd->fn_file),&lst) != 0) return(FALSE);
+    members = (LBX_member *)MEM_alloc(msize*sizeof(LBX_member));
+    syms = (LBX_slot *)MEM_alloc(ssize*sizeof(LBX_slot));
+    lbx_str_size = 4096;
+    lbx_str = MEM_alloc(lbx_str_size);
+    lbx_str_used = 1;           /* offset 0 is the empty string */
+    map_text(fnd);
+    while (get_text() != EOF)
+    {
+        s = inp_ptr;
+        if ((c = *s++) == '\t')
+        {
+            if (nmem == 0) continue;    /* no filename yet */
+            t = s;
+            while (((c = *s) != 0) && !isspace(c)) s++;
+            if (s == t) continue;
+            *s = 0;
+            if (nsym >= ssize)
+            {
+                ssize += ssize/2;
+                syms = (LBX_slot *)MEM_realloc((char *)syms,ssize*sizeof(LBX_slot));
+            }
+            syms[nsym].ls_hash = hashit32(t,&len);
+            syms[nsym].ls_name = lbx_string(t,len);
+            syms[nsym].ls_member = nmem-1;
+            ++nsym;
+            continue;
+        }
+        if (!c || isspace(c)) continue;
+        if (nmem >= msize)
+        {
+            msize += msize/2;
+            members = (LBX_member *)MEM_realloc((char *)members,msize*sizeof(LBX_member));
+        }
+        t = s-1;
+        while (((c = *s) != 0) && !isspace(c)) s++;   /* get the filename */
+        members[nmem].lm_name = lbx_string(t,s-t);
+        members[nmem].lm_date = 0;      /* say there's no date */
+        while (((c = *s) != 0) && c != '"') s++; /* skip to date field */
+        if (c)
+        {          /* is there one? */
+            t = ++s;
+            while (((c = *s) != 0) && c != '"') s++;
+            members[nmem].lm_date = lbx_string(t,s-t);
+        }
+        ++nmem;
+    }
+    unmap_text();
+    rewind(fnd->fn_file);
+
+/* Hash the symbols. If a name appears more than once, the first member */
+/* to list it gets it, the same as library() does. */
+
+    for (hsize=16; hsize < nsym+nsym/2; hsize <<= 1);
+    slots = (LBX_slot *)MEM_alloc(hsize*sizeof(LBX_slot));
+    mask = hsize-1;
+    for (ii=jj=0,ns=syms; ii < nsym; ++ii,++ns)
+    {
+        for (kk=ns->ls_hash&mask;;kk=(kk+1)&mask)
+        {
+            ls = slots+kk;
+            if (ls->ls_name == 0)
+            {
+                *ls = *ns;
+                ++jj;
+                break;
+            }
+            if (ls->ls_hash == ns->ls_hash &&
+                strcmp(lbx_str+ls->ls_name,lbx_str+ns->ls_name) == 0)
+                break;          /* duplicate, first one has it */
+        }
+    }
+    memset((char *)&hdr,0,sizeof(hdr));
+    memcpy(hdr.lbx_magic,LBX_MAGIC,4);
+    hdr.lbx_version = LBX_VERSION;
+    lbx_stamp(&lst,hdr.lbx_stamp);
+    hdr.lbx_members = nmem;
+    hdr.lbx_symbols = jj;
+    hdr.lbx_hashsize = hsize;
+    hdr.lbx_strsize = lbx_str_used;
+    name = lbx_name(fnd);
+    ok = FALSE;
+    if ((fp = fopen(name,"wb")) != 0)
+    {
+        ok = fwrite((char *)&hdr,sizeof(hdr),1,fp) == 1 &&
+             (nmem == 0 || fwrite((char *)members,sizeof(LBX_member),nmem,fp) == nmem) &&
+             fwrite((char *)slots,sizeof(LBX_slot),hsize,fp) == hsize &&
+             fwrite(lbx_str,1,lbx_str_used,fp) == lbx_str_used;
+        if (fclose(fp) != 0) ok = FALSE;
+        if (!ok) remove(name);
+    }
+    if (!ok)
+    {
+        sprintf(emsg,"Unable to write library index \"%s\": %s",
+                name,err2str(errno));
+        err_msg(MSG_WARN,emsg);
+    }
+    else if (debug)
+    {
+        printf("Built library index %s, %u members, %u symbols\n",name,nmem,jj);
+    }
+    MEM_free(name);
+    MEM_free((char *)slots);
+    MEM_free(lbx_str);
+    lbx_str = 0;
+    MEM_free((char *)syms);
+    MEM_free((char *)members);
+    return(ok);
+#else
+    return(FALSE);
+#endif
+}
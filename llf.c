@@ -161,6 +161,34 @@ readonly static int item_terminator=0;
 time_t unix_time;
 int lc_pass;
 
+#define OUT_BUFSIZE (256*1024)	/* default output file buffer size */
+
+/************************************************************************
+ * Give an output file a large buffer so the many short records
+ * written to it go out in a few big writes.
+ */
+static void out_setbuf( FILE *fp )
+/*
+ * At entry:
+ *	fp - newly opened output file, nothing written to it yet
+ * At exit:
+ *	file buffered with -BUFSIZE Kbytes (OUT_BUFSIZE if not given).
+ *	-BUFSIZE=0 leaves it with the stdio default. The buffer is
+ *	held until the image exits.
+ */
+{
+    int32_t size;
+    char *buf;
+
+    size = OUT_BUFSIZE;
+    if (qual_tbl[QUAL_BUFSIZE].present)
+        size = qual_tbl[QUAL_BUFSIZE].valueInt*1024;
+    if (size <= 0) return;
+    buf = MEM_alloc(size);
+    misc_pool_used += size;
+    setvbuf(fp,buf,_IOFBF,size);
+}
+
 /************************************************************************
  * LLF main entry.
  */
@@ -177,6 +205,7 @@ int main( int argc, char *argv[] )
     struct ss_struct  *sym_ptr;
     struct seg_spec_struct *seg_ptr;
     struct fn_struct *nxt_fnd,*lib_fnd;
+    uint32_t nundef;
 #ifdef TIME_LIMIT
     int32_t timed_out,*link_time,systime[2],file_cnt;
 #endif
@@ -232,13 +261,14 @@ int main( int argc, char *argv[] )
     current_fnd = first_inp; /* get input first file name */
     if (output_files[OUT_FN_MAP].fn_present)
     {
-        if ((map_fp = fopen(output_files[OUT_FN_MAP].fn_buff,"w")) == 0)
+        if ((map_fp = wrt_open(output_files[OUT_FN_MAP].fn_buff,"w")) == 0)
         {
             sprintf(emsg,"Error creating MAP file \"%s\": %s",
                     output_files[OUT_FN_MAP].fn_buff,err2str(errno));
             err_msg(MSG_FATAL,emsg);
             EXIT_FALSE;
         }
+        out_setbuf(map_fp);
         misc_pool_used += 280;
         sprintf(map_subtitle=MEM_alloc(280),
                 "Input file synopsis\n\n%-64s%-24s%-8s%-32s\n%s%s%s\n",
@@ -247,6 +277,17 @@ int main( int argc, char *argv[] )
                 "--------------------------------------------",
                 "----------------------------------------");
     }
+    if (output_files[OUT_FN_JSON].fn_present)
+    {
+        if ((jsn_fp = wrt_open(output_files[OUT_FN_JSON].fn_buff,"w")) == 0)
+        {
+            sprintf(emsg,"Error creating JSON file \"%s\": %s",
+                    output_files[OUT_FN_JSON].fn_buff,err2str(errno));
+            err_msg(MSG_FATAL,emsg);
+            EXIT_FALSE;
+        }
+        out_setbuf(jsn_fp);
+    }
     if (output_files[OUT_FN_TMP].fn_present &&
         output_files[OUT_FN_ABS].fn_present)
     {
@@ -344,7 +385,9 @@ int main( int argc, char *argv[] )
             }
             else
             {
+                map_text(current_fnd);  /* map the text if possible */
                 pass1();    /* else do .OL file input */
+                unmap_text();
             }
             if (current_fnd->od_name) ++make_od;
         }
@@ -352,19 +395,39 @@ int main( int argc, char *argv[] )
         {
             if (debug)
                 printf ("Processing library %s\n",current_fnd->fn_buff);
-            nxt_fnd = library();       /* do library processing */
+            sym_undefined(&nundef);
+            if (nundef == 0)
+            {
+                nxt_fnd = current_fnd;     /* nothing for it to resolve */
+            }
+            else if (libidx_open(current_fnd) ||
+                (qual_tbl[QUAL_INDEX].present &&
+                 libidx_build(current_fnd) && libidx_open(current_fnd)))
+            {
+                nxt_fnd = libidx_library();    /* use the compiled index */
+                libidx_close();
+            }
+            else
+            {
+                map_text(current_fnd);
+                nxt_fnd = library();       /* do library processing */
+                unmap_text();
+            }
             if (nxt_fnd == NULL)
 				EXIT_FALSE;
             if (nxt_fnd != current_fnd )
             { /* add anything? */
                 lib_fnd = get_fn_struct();  /* yep, clone us at the end */
                 memcpy(lib_fnd,current_fnd,sizeof(struct fn_struct));
+                lib_fnd->fn_xref_idx = 0;  /* a new file as far as -cross goes */
                 lib_fnd->fn_next = nxt_fnd->fn_next;
                 nxt_fnd->fn_next = lib_fnd;
             }
         }
         fclose (current_fnd->fn_file);
-        id_table_base += current_fnd->fn_max_id+1;
+        finish_tmp_file();      /* bind and fold the file's expressions */
+        finish_symdefs();
+        release_ids();          /* next file gets a fresh ID table */
         if (map_fp)
         {
             if (!current_fnd->fn_library)
@@ -379,6 +442,7 @@ int main( int argc, char *argv[] )
             }
             puts_map(emsg,1);          /* put text into map file */
         }
+        if (jsn_fp) jsn_file(current_fnd);
         if ((current_fnd=current_fnd->fn_next) == 0) break;
     }
     if (map_fp)
@@ -463,6 +527,7 @@ int main( int argc, char *argv[] )
             err_msg(MSG_FATAL,emsg);
             EXIT_FALSE;
         }
+        out_setbuf(abs_fp);
         outid(abs_fp,output_mode);
     }
     if (qual_tbl[QUAL_REL].present)
@@ -479,13 +544,14 @@ int main( int argc, char *argv[] )
             {
                 if (!qual_tbl[QUAL_VLDA].present)
                 {
-                    if ((sym_fp = fopen(output_files[OUT_FN_SYM].fn_buff,"w")) == 0)
+                    if ((sym_fp = wrt_open(output_files[OUT_FN_SYM].fn_buff,"w")) == 0)
                     {
                         sprintf(emsg,"Error creating SYM file \"%s\": %s",
                                 output_files[OUT_FN_SYM].fn_buff,err2str(errno));
                         err_msg(MSG_FATAL,emsg);
                         EXIT_FALSE;
                     }
+                    out_setbuf(sym_fp);
                 }
                 else
                 {
@@ -500,13 +566,14 @@ int main( int argc, char *argv[] )
             {
                 if (!qual_tbl[QUAL_VLDA].present)
                 {
-                    if ((sec_fp = fopen(output_files[OUT_FN_SEC].fn_buff,"w")) == 0)
+                    if ((sec_fp = wrt_open(output_files[OUT_FN_SEC].fn_buff,"w")) == 0)
                     {
                         sprintf(emsg,"Error creating SEC file \"%s\": %s",
                                 output_files[OUT_FN_SEC].fn_buff,err2str(errno));
                         err_msg(MSG_FATAL,emsg);
                         EXIT_FALSE;
                     }
+                    out_setbuf(sec_fp);
                 }
                 else
                 {
@@ -521,7 +588,7 @@ int main( int argc, char *argv[] )
         if ((stb_fp=fopen(output_files[OUT_FN_STB].fn_buff,"w","rfm=var")) == 0)
         {
 #else
-        if ((stb_fp=fopen(output_files[OUT_FN_STB].fn_buff,"wb")) == 0)
+        if ((stb_fp=wrt_open(output_files[OUT_FN_STB].fn_buff,"wb")) == 0)
         {
 #endif
             sprintf(emsg,"Error creating STB file \"%s\": %s",
@@ -529,6 +596,7 @@ int main( int argc, char *argv[] )
             err_msg(MSG_FATAL,emsg);
             EXIT_FALSE;
         }
+        out_setbuf(stb_fp);
         outid(stb_fp,OUTPUT_OBJ);
     }
     outxsym_fp = sec_fp;     /* seg file wanted? */
@@ -595,6 +663,11 @@ int main( int argc, char *argv[] )
     if (qual_tbl[QUAL_REL].present)
 		outxsym_fp = abs_fp;  /* be sure to pickup .externs */
     mapsym();            /* finish up map, sec and sym files */
+    if (jsn_fp)
+    {
+        fclose(jsn_fp);       /* done with the JSON file */
+        jsn_fp = 0;
+    }
     if (sym_fp)
     {
         if (sym_fp != abs_fp)
@@ -608,6 +681,7 @@ int main( int argc, char *argv[] )
             flushsym(output_mode); /* flush out symbol names */
         }
     }
+    if (map_fp) fflush(map_fp);  /* let its writer have the map so far during pass2 */
     lap_timer("MAP file output");
     if (debug) printf ("Write output file\n");
     pass2();         /* do output processing */
@@ -631,7 +705,6 @@ int main( int argc, char *argv[] )
         fclose(abs_fp);       /* close the temp file */
     }
     lap_timer("ABS file output");
-    id_table_base = 0;       /* reset the ID base */
     if (debug)
     {
         printf ("Finish up\n");
@@ -640,6 +713,7 @@ int main( int argc, char *argv[] )
     }
     lap_timer("Image clean up"); /* display accumulated times */
     show_timer();        /* display all accumulated times and stuff */
+    wrt_finish();        /* wait for the sym, sec and stb writers */
     info_enable = 1;     /* enable inforamtional message */
     if ((i=(error_count[4] | error_count[2] | error_count[0])) != 0)
     {
@@ -647,7 +721,13 @@ int main( int argc, char *argv[] )
                 error_count[4]+error_count[2],error_count[0]);
         err_msg(MSG_INFO,emsg);
     }
-    if (map_fp) fclose(map_fp);
+    if (map_fp)
+    {
+        fclose(map_fp);
+        map_fp = 0;
+        wrt_finish();     /* and for the map's */
+    }
+    mem_pool_release();      /* give back all the pools at once */
 #ifdef VMS
     if (error_count[4]) return 0x10000004;
     if (error_count[2]) return 0x10000002;
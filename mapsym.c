@@ -46,9 +46,9 @@ void sort_symbols( void )
     int32_t i,j,ret;
     struct ss_struct **ls,*st,*ost=0,**spp;
 
-    for (j=i=0;i<HASH_TABLE_SIZE;i++)
+    for (j=i=0;i<sym_hash_size;i++)
     {
-        if ((st=hash[(int16_t)i]) != 0)
+        if (sym_hash[i].sh_name != 0 && (st=sym_hash[i].sh_name->nm_sym) != 0)
         {
             do
             {
@@ -71,9 +71,9 @@ void sort_symbols( void )
         misc_pool_used += t;
         ls = (struct ss_struct **)MEM_alloc(t);
         sorted_symbols = ls;
-        for (i=ret=0;i<HASH_TABLE_SIZE;i++)
+        for (i=ret=0;i<sym_hash_size;i++)
         {
-            if ((st=hash[(int16_t)i]) != 0)
+            if (sym_hash[i].sh_name != 0 && (st=sym_hash[i].sh_name->nm_sym) != 0)
             {
                 do
                 {
@@ -119,21 +119,26 @@ int map_line;           /* lines remaining on map page */
 int lines_per_page = 60;
 int columns_per_line = 132;
 
-static void print_map_title( void ) {
+static int title_lines( void ) {
     char *s;
-    fputs(map_title,map_fp);     /* write title line */
-    map_line = lines_per_page-1;     /* reset the line counter */
+    int lines;
+    lines = lines_per_page-1;    /* less the title line */
     if (map_subtitle)
     {
-        fputs(map_subtitle,map_fp);   /* write subtitle line */
         s = map_subtitle;         /* point to subtitle */
-        while (*s) if (*s++ == '\n') --map_line; /* count \n's in text */
+        while (*s) if (*s++ == '\n') --lines; /* count \n's in text */
     }
     else
     {
-        fputs("\n\n",map_fp);     /* write two blank lines */
-        map_line -= 2;            /* count the 2 lines */
+        lines -= 2;               /* count the 2 blank lines */
     }
+    return lines;            /* lines left on a page after its title */
+}
+
+static void print_map_title( void ) {
+    fputs(map_title,map_fp);     /* write title line */
+    fputs(map_subtitle ? map_subtitle:"\n\n",map_fp); /* and subtitle or 2 blank lines */
+    map_line = title_lines();    /* reset the line counter */
     *map_title = '\f';       /* make first char a FF */
     return;
 }
@@ -231,8 +236,7 @@ static char *group_control_stringn0=0;
 
 static void dump_available( void )
 {
-    uint32_t low;
-    struct rm_struct *rm;
+    uint32_t low, addr, rs, rl;
     map_subtitle = "Available areas in the address space\n\n Start  -  End      Size\n-------- --------  --------\n";
     if (map_line < 6)
     {      /* respectable amount of room left? */
@@ -244,26 +248,23 @@ static void dump_available( void )
         puts_map(map_subtitle,0); /* else write the title line */
     }
     low = 0;
-	if (rm_control)
-	{
-		rm = rm_control->top;    /* point to reserved memory list */
-		while (rm)
-		{         /* as long as there is something */   
-			if (rm->rm_start > low)
-			{
-				if ( qual_tbl[QUAL_OCTAL].present )
-					sprintf(emsg, "%08o-%08o  %08o\n",
-							low&0xFFFFFF,
-							(rm->rm_start-1)&0xFFFFFF,
-							(rm->rm_start-low)&0xFFFFFF);
-				else
-					sprintf(emsg, "%08X-%08X  %08X\n",
-							low,rm->rm_start-1,rm->rm_start-low);
-				puts_map(emsg,1);
-			}
-			low = rm->rm_start+rm->rm_len;
-			rm = rm->rm_next;
+	addr = 0;
+	while (get_next_reserve(addr, &rs, &rl))
+	{         /* as long as there is something */   
+		if (rs > low)
+		{
+			if ( qual_tbl[QUAL_OCTAL].present )
+				sprintf(emsg, "%08o-%08o  %08o\n",
+						low&0xFFFFFF,
+						(rs-1)&0xFFFFFF,
+						(rs-low)&0xFFFFFF);
+			else
+				sprintf(emsg, "%08X-%08X  %08X\n",
+						low,rs-1,rs-low);
+			puts_map(emsg,1);
 		}
+		low = rs+rl;
+		addr = rs+1;
 	}
 	if ( qual_tbl[QUAL_OCTAL].present )
 		sprintf(emsg, "%08o-77777777  %08o\n", low&0xFFFFFF, (low == 0 ? -1 : 0 - low)&0xFFFFFF);
@@ -273,6 +274,143 @@ static void dump_available( void )
     return;
 }
 
+/**************************************************************************
+ * The -JSON file. It has one JSON object per line for each input
+ * file, group, segment and symbol, written straight from their
+ * structures with no paging and with names at full length. Values
+ * are unsigned 32 bit decimal numbers.
+ */
+static void jsn_string( const char *s )
+/*
+ * At entry:
+ *	s - pointer to string (0 is taken as "")
+ * At exit:
+ *	string written to the -JSON file quoted and escaped, less any
+ *	trailing blanks (segment and group names are stored with some)
+ */
+{
+    const char *end;
+    int c;
+    putc('"',jsn_fp);
+    if (s)
+    {
+        for (end = s + strlen(s); end > s && end[-1] == ' '; --end);
+        while (s < end)
+        {
+            c = *(const unsigned char *)s++;
+            if (c == '"' || c == '\\')
+            {
+                putc('\\',jsn_fp);
+                putc(c,jsn_fp);
+            }
+            else if (c < ' ')
+            {
+                fprintf(jsn_fp,"\\u%04x",c);
+            }
+            else
+            {
+                putc(c,jsn_fp);
+            }
+        }
+    }
+    putc('"',jsn_fp);
+}
+
+/**************************************************************************
+ * jsn_file - write an input file's synopsis to the -JSON file
+ */
+void jsn_file( struct fn_struct *fnd )
+{
+    fputs("{\"type\":\"file\",\"name\":",jsn_fp);
+    jsn_string(fnd->fn_buff);
+    if (fnd->fn_library)
+    {
+        fputs(",\"library\":true}\n",jsn_fp);
+        return;
+    }
+    fputs(",\"library\":false,\"date\":",jsn_fp);
+    jsn_string(fnd->fn_credate);
+    fputs(",\"target\":",jsn_fp);
+    jsn_string(fnd->fn_target);
+    fputs(",\"translator\":",jsn_fp);
+    jsn_string(fnd->fn_xlator);
+    fputs("}\n",jsn_fp);
+}
+
+static void jsn_group( struct ss_struct *grp_nam, struct seg_spec_struct *grp_seg, int32_t end )
+{
+    fputs("{\"type\":\"group\",\"name\":",jsn_fp);
+    jsn_string(grp_nam->ss_string);
+    fprintf(jsn_fp,",\"base\":%lu,\"end\":%lu,\"size\":%lu,\"maxlen\":%lu}\n",
+            (unsigned long)(uint32_t)grp_nam->ss_value,
+            (unsigned long)(uint32_t)end,
+            (unsigned long)(uint32_t)grp_seg->seg_len,
+            (unsigned long)(uint32_t)grp_seg->seg_maxlen);
+}
+
+static void jsn_segment( struct ss_struct *grp_nam, struct ss_struct *ms,
+                         int32_t lim, int32_t lalign, const char *fno )
+{
+    struct seg_spec_struct *seg_ptr = ms->seg_spec;
+    fputs("{\"type\":\"segment\",\"name\":",jsn_fp);
+    jsn_string(ms->ss_string);
+    fputs(",\"group\":",jsn_fp);
+    jsn_string(grp_nam->ss_string);
+    fprintf(jsn_fp,",\"base\":%lu,\"end\":%lu,\"size\":%lu,\"maxlen\":%lu,\"align\":%ld,\"overlaid\":%s,\"file\":",
+            (unsigned long)(uint32_t)ms->ss_value,
+            (unsigned long)(uint32_t)lim,
+            (unsigned long)(uint32_t)seg_ptr->seg_len,
+            (unsigned long)(uint32_t)seg_ptr->seg_maxlen,
+            (long)lalign,
+            ms->flg_ovr ? "true":"false");
+    jsn_string(fno);
+    fputs("}\n",jsn_fp);
+}
+
+static void jsn_symbols( void )
+{
+    struct ss_struct *st,**ls;
+    XREF_struct *xr;
+    XREF_blk *blk;
+    int i,cnt;
+
+    if ((ls = sorted_symbols) == 0) return;
+    while ((st = *ls++) != 0)
+    {
+        fputs("{\"type\":\"symbol\",\"name\":",jsn_fp);
+        jsn_string(st->ss_string);
+        fprintf(jsn_fp,",\"value\":%lu,\"defined\":%s,\"local\":%s",
+                (unsigned long)(uint32_t)st->ss_value,
+                st->flg_defined ? "true":"false",
+                st->flg_local ? "true":"false");
+        if (st->ss_fnd)
+        {
+            fputs(",\"file\":",jsn_fp);
+            jsn_string(st->ss_fnd->fn_name_only);
+        }
+        if ((xr = st->ss_xref) != 0)
+        {
+            fputs(",\"xref\":[",jsn_fp);
+            cnt = 0;
+            if (xr->xr_def)
+            {
+                jsn_string(xref_fnd[xr->xr_def]->fn_name_only);
+                ++cnt;
+            }
+            blk = &xr->xr_head;
+            for (i=0; i < xr->xr_count; ++i)
+            {
+                if (i && !(i%XREF_BLOCK_SIZE)) blk = blk->xb_next;
+                if (blk->xb_idx[i%XREF_BLOCK_SIZE] == xr->xr_def) continue;
+                if (cnt++) putc(',',jsn_fp);
+                jsn_string(xref_fnd[blk->xb_idx[i%XREF_BLOCK_SIZE]]->fn_name_only);
+            }
+            putc(']',jsn_fp);
+        }
+        fputs("}\n",jsn_fp);
+    }
+}
+
 /**************************************************************************
  * map_seg_summary - display the segment summary in the map file
  */
@@ -281,7 +419,7 @@ static void map_seg_summary( void )
  * At entry:
  *	no special requirements
  * At exit:
- *	map file contains segment listing
+ *	map file contains segment listing, and so does the -JSON file
  */
 {
     int32_t i;
@@ -363,12 +501,13 @@ static void map_seg_summary( void )
             {
                 ls = (struct ss_struct **)*ls; continue;
             }
-            if (map_fp)
+            if (map_fp || jsn_fp)
             {
                 if (!i++)
                 {
                     int32_t end = grp_seg->seg_len;
                     end += (end == 0) ? grp_nam->ss_value : grp_nam->ss_value-1;
+                    if (jsn_fp) jsn_group(grp_nam,grp_seg,end);
                     if (grp_seg->seg_maxlen != 0)
                     {
                         sprintf (emsg,group_control_stringn0,
@@ -387,6 +526,29 @@ static void map_seg_summary( void )
                                  grp_seg->seg_len);
                     }
                     puts_map(emsg,1);
+                    if (grp_seg->sflg_fit && (grp_seg->seg_fill_free != 0 || grp_seg->seg_fill_nover != 0))
+                    {
+                        uint32_t pct = 0;
+                        int len;
+                        if (grp_seg->seg_fill_free != 0)
+                            pct = (uint32_t)((double)grp_seg->seg_fill_used*1000.0/grp_seg->seg_fill_free);
+                        len = sprintf(emsg,"\t(FIT packed %lu of %lu free bytes, %lu.%lu%% full",
+                                      (unsigned long)grp_seg->seg_fill_used,
+                                      (unsigned long)grp_seg->seg_fill_free,
+                                      (unsigned long)pct/10, (unsigned long)pct%10);
+                        if (grp_seg->seg_fill_nover != 0)
+                        {
+                            sprintf(emsg+len,"; %lu bytes in %lu segment%s placed past TO)\n",
+                                    (unsigned long)grp_seg->seg_fill_over,
+                                    (unsigned long)grp_seg->seg_fill_nover,
+                                    grp_seg->seg_fill_nover == 1 ? "" : "s");
+                        }
+                        else
+                        {
+                            strcpy(emsg+len,")\n");
+                        }
+                        puts_map(emsg,1);
+                    }
                 }
             }
             ms = st;
@@ -453,6 +615,7 @@ static void map_seg_summary( void )
                                 fno);
                     }
                     puts_map(emsg,1);
+                    if (jsn_fp) jsn_segment(grp_nam,ms,lim,lalign,fno);
                 }
                 if (!ms->flg_more) break;
                 ms = ms->ss_next;
@@ -467,8 +630,141 @@ static void map_seg_summary( void )
     map_subtitle = 0;        /* make sure we don't use freed memory */
 }               /* --map_seg_summary	*/
 
-static char *sym_control_string=0;
-static char *sym_control_string_xr=0;
+static char hexdig[] = "0123456789ABCDEF";
+
+/**************************************************************************
+ * map_sym_text - format a symbol's name and value for the map
+ */
+static char *map_sym_text( char *d, struct ss_struct *st )
+/*
+ * At entry:
+ *	d - pointer to place to put text
+ *	st - pointer to symbol
+ * At exit:
+ *	returns pointer past the text, which is the same as what
+ *	"%-16.16s %08lX" (or "%-14.14s %010lo" with -octal) would
+ *	produce, without the null. Called once per symbol, so done
+ *	by hand rather than with sprintf.
+ */
+{
+    const char *s;
+    uint32_t val;
+    int ii,width;
+
+    width = qual_tbl[QUAL_OCTAL].present ? 14:16;
+    s = st->ss_string;
+    for (ii=0; ii < width && *s; ++ii) *d++ = *s++;
+    for (; ii < width; ++ii) *d++ = ' ';
+    *d++ = ' ';
+    val = st->ss_value;
+    if (qual_tbl[QUAL_OCTAL].present)
+    {
+        width = (val >> 30) ? 11:10;
+        for (ii=width; ii-- > 0; val >>= 3) d[ii] = '0' + (val&7);
+        d += width;
+    }
+    else
+    {
+        for (ii=28; ii >= 0; ii -= 4) *d++ = hexdig[(val>>ii)&15];
+    }
+    return d;
+}
+
+#define MAP_BATCH	32	/* symbol summary pages formatted at a time */
+
+typedef struct map_pg
+{
+    struct ss_struct **mp_syms;	/* where the page's symbols start */
+    int mp_cols;		/* columns on the page */
+    int mp_lines;		/* lines on the page */
+    int mp_short;		/* first column isn't full */
+    char *mp_text;		/* page text, 132 bytes per line */
+} MapPage_t;
+
+/**************************************************************************
+ * map_page_layout - decide what goes on a symbol summary page
+ */
+static struct ss_struct **map_page_layout( MapPage_t *mp, struct ss_struct **ls, int line_page )
+/*
+ * At entry:
+ *	mp - page to fill in
+ *	ls - pointer to next symbol in sorted_symbols
+ *	line_page - lines left on the map page
+ * At exit:
+ *	mp has the page's columns, lines and first symbol. tot_gbl
+ *	reduced by the symbols on the page. Returns pointer to the
+ *	symbol that starts the next page.
+ */
+{
+    int i,lc,filled,col;
+
+    col = 5;             /* set columns */
+    if (((tot_gbl+line_page-1)/line_page) < col)
+    {
+        while (1)
+        {
+            if ((line_page = (tot_gbl+col-1)/col) >= 5) break;
+            if (col == 1) break;
+            --col;
+        }
+    }
+    mp->mp_syms = ls;
+    mp->mp_cols = col;
+    mp->mp_lines = line_page;
+    filled = 0;
+    for (i=0;i<col && *ls;i++)
+    {
+        for (lc=0;lc<line_page && *ls;lc++)
+        {
+            while (*ls && !(*ls)->flg_defined) ls++;
+            if (!*ls) break;
+            ls++;
+            --tot_gbl;       /* take from total */
+            if (!i) ++filled;
+        }
+    }
+    mp->mp_short = filled < line_page;
+    return ls;
+}
+
+/**************************************************************************
+ * map_page_text - format a symbol summary page
+ */
+static void map_page_text( void *arg, int job )
+/*
+ * At entry:
+ *	arg - pointer to array of MapPage_t
+ *	job - which one to format
+ * At exit:
+ *	page text filled in, one column at a time. Lines the first
+ *	column doesn't reach are left as they were. Called from
+ *	wrk_run() so it only reads the symbols.
+ */
+{
+    MapPage_t *mp = (MapPage_t *)arg + job;
+    struct ss_struct *st,**ls;
+    int i,lc;
+    char *d;
+
+    ls = mp->mp_syms;
+    for (i=0;i<mp->mp_cols && *ls;i++)
+    {
+        for (lc=0;lc<mp->mp_lines && *ls;lc++)
+        {
+            d = mp->mp_text + lc*132 + i*26; /* point to destination */
+            while ((st = *ls) != 0)
+            {
+                ls++;
+                if (st->flg_defined)
+                {
+                    d = map_sym_text(d,st);
+                    strcpy(d," \n");
+                    break;
+                }       /* --if 	*/
+            }          /* --while	*/
+        }         /* --do vertical */
+    }            /* --do horiz	*/
+}
 
 /**************************************************************************
  * MAPSYM - create a map and symbol file
@@ -485,22 +781,16 @@ void mapsym( void )
     struct ss_struct *st,**ls;
     int i,lc,col,line_page;
     char *d,*map_page;
-    struct fn_struct **fnp_ptr,*fn_ptr;
+    struct fn_struct *fn_ptr;
+    XREF_struct *xr;
+    XREF_blk *blk;
+    int32_t idx;
 
+    if (map_fp || jsn_fp)
+        map_seg_summary();
     if (map_fp)
     {
-        map_seg_summary();
         map_subtitle = "Symbol summary\n\n";
-        if (qual_tbl[QUAL_OCTAL].present)
-        {
-            sym_control_string = "%-14.14s %010lo \n";
-            sym_control_string_xr = "%-14.14s %010lo\n";
-        }
-        else
-        {
-            sym_control_string = "%-16.16s %08lX \n";
-            sym_control_string_xr = "%-16.16s %08lX\n";
-        }
         if (map_line < 6)
         {
             puts_map(0l,0);
@@ -515,45 +805,52 @@ void mapsym( void )
             int map_page_size = 132*60;
             if (!qual_tbl[QUAL_CROSS].present)
             {     /* not cross reference mode */
-                misc_pool_used += 132*60;
-                map_page = MEM_alloc(132*60);   /* get a whole map page of memory */
+                MapPage_t pages[MAP_BATCH];
+                int npage,nfmt,started;
+
+                /* Pages are laid out here a batch at a time, formatted
+                 * by wrk_run() each into its own buffer, then written
+                 * in order. A page whose first column isn't full can
+                 * only be the last one; it shows whatever the page
+                 * before it left in the lines the column doesn't
+                 * reach, so it starts with a copy of that page and is
+                 * formatted after the others. */
+                map_page_size = MAP_BATCH*132*60;
+                misc_pool_used += map_page_size;
+                map_page = MEM_alloc(map_page_size); /* get a batch of map pages of memory */
+                line_page = map_line;    /* set lines per page */
+                started = 0;         /* no pages written yet */
                 while (1)
                 {
-                    col = 5;         /* set columns */
-                    line_page = map_line;    /* set lines per page */
-                    if (((tot_gbl+line_page-1)/line_page) < col)
+                    for (npage=0; npage < MAP_BATCH; )
                     {
-                        while (1)
-                        {
-                            if ((line_page = (tot_gbl+col-1)/col) >= 5) break;
-                            if (col == 1) break;
-                            --col;
-                        }
+                        pages[npage].mp_text = map_page + npage*132*60;
+                        ls = map_page_layout(pages+npage,ls,line_page);
+                        ++npage;
+                        line_page = title_lines(); /* the rest follow a title */
+                        if (!*ls) break;
                     }
-                    for (i=0;i<col && *ls;i++)
+                    nfmt = npage;
+                    if (pages[npage-1].mp_short)
                     {
-                        for (lc=0;lc<line_page && *ls;lc++)
-                        {
-                            d = map_page + lc*132 + i*26; /* point to destination */
-                            while ((st = *ls) != 0)
-                            {
-                                if (st->flg_defined)
-                                {
-                                    sprintf(d,sym_control_string,st->ss_string,st->ss_value);
-                                    ls++;
-                                    --tot_gbl;   /* take from total */
-                                    break;
-                                }       /* --if 	*/
-                                ls++;
-                            }          /* --while	*/
-                        }         /* --do vertical */
-                    }            /* --do horiz	*/
-                    for (i=line_page,lc=0;lc<i;lc++)
+                        --nfmt;
+                        if (npage > 1)
+                            memcpy(pages[npage-1].mp_text,pages[npage-2].mp_text,132*60);
+                        else if (started)
+                            memcpy(pages[0].mp_text,map_page+(MAP_BATCH-1)*132*60,132*60);
+                    }
+                    wrk_run(nfmt,map_page_text,pages);
+                    if (nfmt < npage) map_page_text(pages,nfmt);
+                    for (i=0; i < npage; ++i)
                     {
-                        puts_map(map_page+lc*132,1);
-                    }            /* --do write	*/
+                        if (started) puts_map(0l,0); /* skip to tof to reset map_line */
+                        for (lc=0; lc < pages[i].mp_lines; lc++)
+                        {
+                            puts_map(pages[i].mp_text+lc*132,1);
+                        }        /* --do write	*/
+                        started = 1;
+                    }
                     if (!*ls) break;     /* done 	*/
-                    puts_map(0l,0);      /* skip to tof to reset map_line */
                 }               /* --while (1)	*/
             }
             else
@@ -563,21 +860,26 @@ void mapsym( void )
                 map_page_size = 132+4;
                 while ((st = *ls++) != 0)
                 {
-                    sprintf(map_page,sym_control_string_xr,st->ss_string,st->ss_value);
+                    strcpy(map_sym_text(map_page,st),"\n");
                     col = 25;
                     d = map_page + col;  /* point to new line char */
-                    if ((fnp_ptr = st->ss_xref) != 0)
+                    if ((xr = st->ss_xref) != 0)
                     {
-                        i = 0;
-                        while ((fn_ptr= *fnp_ptr++) != 0)
-                        {
-                            if (i++ >= XREF_BLOCK_SIZE - 1)
+                        blk = &xr->xr_head;
+                        for (i = -1; i < xr->xr_count; ++i)
+                        {   /* defining file (if any) goes first */
+                            if (i < 0)
+                            {
+                                idx = xr->xr_def;
+                            }
+                            else
                             {
-                                fnp_ptr = (struct fn_struct **)fn_ptr;
-                                i = 0;
-                                continue;
+                                if (i && !(i%XREF_BLOCK_SIZE)) blk = blk->xb_next;
+                                idx = blk->xb_idx[i%XREF_BLOCK_SIZE];
+                                if (idx == xr->xr_def) continue;  /* listed first */
                             }
-                            if (fn_ptr == (struct fn_struct *)-1l) continue;
+                            if (!idx) continue;  /* no defining file */
+                            fn_ptr = xref_fnd[idx];
                             lc = strlen(fn_ptr->fn_name_only);
                             if (lc+4+col > 131)
                             {
@@ -693,6 +995,7 @@ void mapsym( void )
             }              /* --while	*/
         }                 /* --if sorted_symbols */
     }                    /* --if udf	*/
+    if (jsn_fp) jsn_symbols();
     return;
 }                   /* --mapsym	*/
 
@@ -702,6 +1005,9 @@ static int chain_max=0;
 static int coll=0;
 static int ht_coll=0;
 static int tot_seg=0;
+static int ht_nosym=0;
+static uint32_t probe_max=0;
+static uint32_t probe_tot=0;
 
 /********************************************************************
  * Get symbol table statistics. For debugging purposes mainly.
@@ -715,16 +1021,21 @@ void sym_stats( void )
  */
 {
     int i,j=0;
+    uint32_t probe;
     struct ss_struct *st;
     if (debug)
     {
-        for (i=0;i<HASH_TABLE_SIZE;i++,j=0)
+        for (i=0;i<sym_hash_size;i++,j=0)
         {
-            if ((st=hash[(int16_t)i]) != 0)
+            if (sym_hash[i].sh_name == 0) continue;  /* empty slot */
+            if ((st=sym_hash[i].sh_name->nm_sym) != 0)
             {
                 ++ht_count;         /* a hash table entry */
+                probe = (i - sym_hash[i].sh_hash)&(sym_hash_size-1);
+                if (probe) ++ht_coll;   /* not in its home slot */
+                if (probe_max < probe) probe_max = probe;
+                probe_tot += probe;
                 tot_seg += st->flg_segment;
-                if (st->ss_next) ++ht_coll; /* a collision */
                 while ((st = st->ss_next) != 0)
                 {
                     tot_seg += st->flg_segment;
@@ -734,16 +1045,21 @@ void sym_stats( void )
                 if (chain_max < j) chain_max = j;
                 if (j && chain_min > j) chain_min = j;
             }
+            else
+            {
+                ++ht_nosym;         /* name interned but no symbol */
+            }
         }
-        sprintf (emsg,"\nTot hash table entries: %d, alpha: .%02d, colls: %d\n",
-                 ht_count,ht_count*100/HASH_TABLE_SIZE,coll);
+        sprintf (emsg,"\nTot hash table entries: %d of %u, alpha: .%02d, names w/o symbols: %d, dups: %d\n",
+                 ht_count,sym_hash_size,(int)((ht_count+ht_nosym)*100/sym_hash_size),ht_nosym,coll);
         puts_map(emsg,2);
-        sprintf (emsg,"\ttot table collisions: %d, Total chains: %d\n",
-                 ht_coll,coll);
+        sprintf (emsg,"\tentries not in home slot: %d, probe_max: %u, probe_avg: %u.%02u\n",
+                 ht_coll,probe_max,ht_count ? probe_tot/ht_count : 0,
+                 ht_count ? (probe_tot*100/ht_count)%100 : 0);
         puts_map(emsg,1);
-        i = ht_coll ? coll/ht_coll : 0;
-        sprintf (emsg,"\tchain_max: %d, chain_min: %d, chain_avg: %d\n",
-                 chain_max,i?chain_min:0,i);
+        i = coll;
+        sprintf (emsg,"\tdup chain_max: %d, dup chain_min: %d\n",
+                 chain_max,i?chain_min:0);
         puts_map(emsg,1);
         sprintf (emsg,"\ttotal segments: %d, total global sym entries: %d, glob syms: %d\n",
                  tot_seg,j=ht_count+coll-tot_seg,tot_gbl);
@@ -753,8 +1069,8 @@ void sym_stats( void )
         sprintf (emsg,"\ttotal ID's used: %d, maximum ID # used : %d\n",
                  tot_ids,max_idu);
         puts_map(emsg,1);
-        sprintf (emsg,"\ttotal ID's allocated: %d, total ID's unused: %d\n",
-                 id_table_size,id_table_size-tot_ids);
+        sprintf (emsg,"\tmost ID's allocated at once: %d\n",
+                 id_table_size);
         puts_map(emsg,1);
     }
     return;
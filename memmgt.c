@@ -16,6 +16,29 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+/********************************************************************
+ *
+ * This module does LLF's memory management. There are two kinds of
+ * allocation:
+ *
+ * MEM_alloc()/MEM_realloc()/MEM_free() are for things that may be
+ * resized or given back. Each has a header in front of it. With
+ * DEBUG_MALLOC defined, the header records who allocated it and links
+ * it into a list, and a trailer follows it, so the whole heap can be
+ * checked for overruns on every call. Without it, the header is only
+ * the size and a magic number.
+ *
+ * MEM_pool() is for the bulk pools (symbol blocks, segment blocks,
+ * filename and token pools, xref blocks, etc.) that are never freed
+ * or resized. In release builds these are carved out of large regions
+ * with a bump pointer: no per-object header and no extra zeroing
+ * (regions come from calloc(), so they start out 0'd and are never
+ * reused). All regions are released at once by mem_pool_release().
+ * With DEBUG_MALLOC defined MEM_pool() is just MEM_alloc() so pool
+ * chunks get the same checking as everything else.
+ *
+ *******************************************************************/
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -31,10 +54,12 @@ int32_t peak_mem_used;
 typedef struct hdr
 {
     uint32_t size;
+#if defined(DEBUG_MALLOC)
     void *caller;
     int line;
     char *file;
     struct hdr *next, *prev;
+#endif
     uint32_t magic;
 } Hdr;
 
@@ -45,11 +70,30 @@ typedef struct hdr
 
 #if defined(DEBUG_MALLOC)
 static Hdr *top, *bottom;
+#define TAIL_SIZE	sizeof(int32_t)	/* room for POST_MAGIC */
+#else
+#define TAIL_SIZE	0		/* no trailer */
 #endif
 
+typedef struct region
+{
+    struct region *next;	/* next region in chain */
+    int size;			/* size of region including this header */
+} Region;
+
+#define POOL_REGION_SIZE (256*1024)	/* normal size of a pool region */
+#define POOL_ALIGN	8		/* alignment of pool allocations */
+#define REGION_HDR	((sizeof(Region)+POOL_ALIGN-1)&~(POOL_ALIGN-1))
+
+static Region *pool_regions;	/* all the regions */
+static char *pool_next;		/* next free byte in current region */
+static int pool_left;		/* bytes left in current region */
+
 static char *check(Hdr *hdr) {
     char *msg = 0;
+#if defined(DEBUG_MALLOC)
     uint32_t *end;
+#endif
 
     if (hdr->magic != PRE_MAGIC)
     {
@@ -62,6 +106,7 @@ static char *check(Hdr *hdr) {
             msg = "%%%s-F-FATAL, %s:%d tried to free %08lX with corrupted header.\n";
         }
     }
+#if defined(DEBUG_MALLOC)
     else
     {
         end = (uint32_t *)((char *)(hdr+1)+hdr->size);
@@ -70,6 +115,7 @@ static char *check(Hdr *hdr) {
             msg = "%%%s-F-FATAL, %s:%d tried to free %08lX with corrupted tail.\n";
         }
     }
+#endif
     return msg;
 }
 
@@ -133,10 +179,12 @@ int mem_free(char *s, char *file, int line) {
 char *mem_alloc(int nbytes, char *file, int line) {
     char *s;
     Hdr *hdr;
+#if defined(DEBUG_MALLOC)
     uint32_t *end;
+#endif
     int siz;
     nbytes = (nbytes + (sizeof(int32_t)-1)) & ~(sizeof(int32_t)-1);
-    siz = nbytes + sizeof(Hdr) + sizeof(int32_t);
+    siz = nbytes + sizeof(Hdr) + TAIL_SIZE;
     hdr = (Hdr *)calloc((unsigned int)siz,(unsigned int)1);  /* get some memory from OS */
     if (hdr == (Hdr *)0)
     {
@@ -146,13 +194,13 @@ char *mem_alloc(int nbytes, char *file, int line) {
         abort();
     }
     hdr->size = nbytes;
-    hdr->file = file;
-    hdr->line = line;
     hdr->magic = PRE_MAGIC;
     s = (char *)(hdr+1);
+#if defined(DEBUG_MALLOC)
+    hdr->file = file;
+    hdr->line = line;
     end = (uint32_t *)(s+nbytes);
     *end = POST_MAGIC;
-#if defined(DEBUG_MALLOC)
     if (top == 0)
     {
         top = hdr;
@@ -173,9 +221,9 @@ char *mem_realloc(char *old, int nbytes, char *file, int line) {
     Hdr *hdr;
 #if defined(DEBUG_MALLOC)
     Hdr *prev, *next;
+    uint32_t *end;
 #endif
     int siz;
-    uint32_t *end;
 
     if (old != 0)
     {
@@ -187,7 +235,8 @@ char *mem_realloc(char *old, int nbytes, char *file, int line) {
                     macxx_name, file, line, old);
             abort();
         }
-        total_mem_used -= siz+sizeof(Hdr)+sizeof(int32_t);
+        total_mem_used -= siz+sizeof(Hdr)+TAIL_SIZE;
+#if defined(DEBUG_MALLOC)
         end = (uint32_t *)(old+hdr->size);
         if (*end != POST_MAGIC)
         {
@@ -196,15 +245,14 @@ char *mem_realloc(char *old, int nbytes, char *file, int line) {
             if (hdr->line > 0) fprintf(stderr, "              area allocated by %s:%d\n", hdr->file, hdr->line);
             abort();
         }
-#if defined(DEBUG_MALLOC)
         check_all();
         next = hdr->next;
         prev = hdr->prev;
-#endif
         *end = 0;
+#endif
 
         nbytes = (nbytes + (sizeof(int32_t)-1)) & ~(sizeof(int32_t)-1);
-        siz = nbytes + sizeof(Hdr) + sizeof(int32_t);
+        siz = nbytes + sizeof(Hdr) + TAIL_SIZE;
         s = (char *)realloc((char *)hdr, siz);
         if (s == NFG)
         {
@@ -214,8 +262,10 @@ char *mem_realloc(char *old, int nbytes, char *file, int line) {
             abort();
         }
         hdr = (Hdr *)s;
+#if defined(DEBUG_MALLOC)
         hdr->file = file;
         hdr->line = line;
+#endif
         hdr->magic = PRE_MAGIC;
         if (nbytes > hdr->size)
         {     /* 0 the newly alloc'd  area */
@@ -223,10 +273,10 @@ char *mem_realloc(char *old, int nbytes, char *file, int line) {
             memset(s, 0, nbytes-hdr->size);
         }
         s = (char *)(hdr+1);
-        end = (uint32_t *)(s+nbytes);
-        *end = POST_MAGIC;
         hdr->size = nbytes;
 #if defined(DEBUG_MALLOC)
+        end = (uint32_t *)(s+nbytes);
+        *end = POST_MAGIC;
         hdr->next = next;
         hdr->prev = prev;
         if (next) next->prev = hdr;
@@ -242,3 +292,94 @@ char *mem_realloc(char *old, int nbytes, char *file, int line) {
         return mem_alloc(nbytes, file, line);
     }
 }
+
+#if !defined(DEBUG_MALLOC)
+/************************************************************************
+ * Get a new pool region
+ */
+static Region *new_region( int size, char *file, int line )
+/*
+ * At entry:
+ *	size - number of bytes needed (including the Region header)
+ *	file, line - who wanted it (for error messages)
+ * At exit:
+ *	returns pointer to 0'd region linked into pool_regions
+ */
+{
+    Region *r;
+    r = (Region *)calloc((size_t)size,(size_t)1);
+    if (r == (Region *)0)
+    {
+        fprintf(stderr,"%%%s-F-FATAL, %s:%d Ran out of memory requesting %d bytes. Used %d so far.\n",
+                macxx_name, file, line, size, total_mem_used);
+        fprintf(stderr,"%s",emsg);
+        abort();
+    }
+    r->size = size;
+    r->next = pool_regions;
+    pool_regions = r;
+    total_mem_used += size;
+    if (total_mem_used > peak_mem_used) peak_mem_used = total_mem_used;
+    return r;
+}
+#endif
+
+/************************************************************************
+ * Get memory from the bulk pool
+ */
+char *mem_pool(int nbytes, char *file, int line)
+/*
+ * At entry:
+ *	nbytes - number of bytes wanted
+ *	file, line - who wants it
+ * At exit:
+ *	returns pointer to 0'd memory that is never to be passed
+ *	to MEM_free() or MEM_realloc().
+ */
+{
+#if defined(DEBUG_MALLOC)
+    return mem_alloc(nbytes, file, line);
+#else
+    char *s;
+    Region *r;
+    nbytes = (nbytes + POOL_ALIGN-1) & ~(POOL_ALIGN-1);
+    if (nbytes > pool_left)
+    {
+        if (nbytes > POOL_REGION_SIZE/4)
+        {   /* big ones get a region of their own */
+            r = new_region(nbytes+REGION_HDR, file, line);
+            return (char *)r + REGION_HDR;
+        }
+        r = new_region(POOL_REGION_SIZE, file, line);
+        pool_next = (char *)r + REGION_HDR;
+        pool_left = POOL_REGION_SIZE - REGION_HDR;
+    }
+    s = pool_next;
+    pool_next += nbytes;
+    pool_left -= nbytes;
+    return s;
+#endif
+}
+
+/************************************************************************
+ * Release all the bulk pool memory
+ */
+void mem_pool_release( void )
+/*
+ * At entry:
+ *	no requirements. Nothing obtained from MEM_pool() may be used
+ *	after this.
+ * At exit:
+ *	all regions have been given back
+ */
+{
+    Region *r;
+    while ((r = pool_regions) != 0)
+    {
+        pool_regions = r->next;
+        total_mem_used -= r->size;
+        free((char *)r);
+    }
+    pool_next = 0;
+    pool_left = 0;
+}
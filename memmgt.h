@@ -27,6 +27,9 @@ extern int   mem_free(char *old, char *file, int line);
 #define MEM_malloc(size) mem_alloc(size, __FILE__, __LINE__)
 #define MEM_free(area) mem_free((char *)(area), __FILE__, __LINE__)
 #define MEM_realloc(area, size) mem_realloc((char *)(area), size, __FILE__, __LINE__)
+extern char *mem_pool(int size, char *file, int line);	/* bulk pool allocation (never free'd) */
+extern void  mem_pool_release(void);
+#define MEM_pool(size) mem_pool(size, __FILE__, __LINE__)
 
 #endif
 
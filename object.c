@@ -364,26 +364,17 @@ static struct ss_struct *new_sym( int flag )
  * At exit:
  *	returns pointer to symbol block
  *	new_symbol contains status about symbol insert
- *	token_pool may have been updated in order to keep symbol
+ *	the name has been interned, token_pool is not used up
  */
 {
     struct ss_struct *sym_ptr;
     sym_ptr = sym_lookup(token_pool,++token_value,flag);
     switch (new_symbol)
     {
-    case 5: {
-            sym_ptr->ss_string = first_symbol->ss_string;
-            sym_ptr->ss_fnd = current_fnd;
-            break;
-        }
+    case 5:
     case 1:
     case 3: {
-            sym_ptr->ss_fnd = current_fnd;
-            if (token_value > 1)
-            {
-                token_pool += token_value;  /* update the free mem pointer */
-                token_pool_size -= token_value; /* and size */
-            }
+            sym_ptr->ss_fnd = current_fnd; /* name is in the arena */
         }
     case 0: break;
     default: {
@@ -425,7 +416,7 @@ static void do_gsd( int len, struct gsdstruct *gsdptr )
         int tsiz = MAX_TOKEN*8;
         if (len*7 > tsiz) tsiz += len*7;
         token_pool_size = tsiz;
-        token_pool = MEM_alloc(tsiz);
+        token_pool = MEM_pool(tsiz);
         misc_pool_used += token_pool_size;
     }
     for (; len > 0; --len,gsdptr++)
@@ -1164,14 +1155,14 @@ static void inp_vldaexp( char *ptr )
         case VLDA_EXPR_L:
         case VLDA_EXPR_B:
             expr->expr_code = (ve_code == VLDA_EXPR_L) ? EXPR_L : EXPR_B;
-            expr->ss_ptr = id_table[id_table_base+ *ve.vexp_ident++];
+            expr->ss_ptr = get_id(*ve.vexp_ident++);
             goto vldainp_comm1;
         case VLDA_EXPR_CSYM:   /* symbol or segment */
         case VLDA_EXPR_SYM:    /* symbol or segment */
             expr->expr_code = EXPR_IDENT;
             expr->ss_id = (ve_code == VLDA_EXPR_CSYM) ? 
-                          (id_table_base+ (*ve.vexp_byte++ & 0xFF)):
-                          (id_table_base+ *ve.vexp_ident++);
+                          (*ve.vexp_byte++ & 0xFF):
+                          *ve.vexp_ident++;
 vldainp_comm1:
             expr->expr_value = 0;
             if ( !expr->ss_ptr && !expr->ss_id )
@@ -1308,7 +1299,7 @@ void object( int fd )
             if (token_pool_size <= MAX_TOKEN )
             {
                 token_pool_size = MAX_TOKEN*8;
-                token_pool = MEM_alloc(token_pool_size);
+                token_pool = MEM_pool(token_pool_size);
                 misc_pool_used += token_pool_size;
             }
 #if defined(VMS) && defined(RT11_RSX)
@@ -1494,8 +1485,7 @@ void object( int fd )
                     }
                     else
                     {             /* symbol */
-                        if (id_table_base+vsym->vsym_ident < id_table_size && 
-                            (sym_ptr = *(id_table+id_table_base+vsym->vsym_ident)) != 0)
+                        if ((sym_ptr = get_id(vsym->vsym_ident)) != 0)
                         {
                             if (strcmp(sym_ptr->ss_string,token_pool) != 0 )
                             {
@@ -1517,7 +1507,7 @@ void object( int fd )
                                     sym_ptr = (SS_struct *)get_symbol_block(1);
                                     sym_ptr->ss_fnd = current_fnd;
                                     sym_ptr->ss_string = osp->ss_string;
-                                    *(id_table+id_table_base+vsym->vsym_ident) = sym_ptr;
+                                    set_id(vsym->vsym_ident,sym_ptr);
                                 }
                             }
                         }
@@ -1527,9 +1517,7 @@ void object( int fd )
                             {
                                 sym_ptr = (struct ss_struct *)get_symbol_block(1);
                                 sym_ptr->ss_fnd = current_fnd;
-                                sym_ptr->ss_string = token_pool;
-                                token_pool += token_value+1;    /* update the free mem pointer */
-                                token_pool_size -= token_value+1; /* and size */
+                                sym_ptr->ss_string = name_intern(token_pool,1)->nm_string;
                             }
                             else
                             {
@@ -1593,8 +1581,7 @@ void object( int fd )
                     continue;
                 }           /* -- case VLDA_GSD */
             case VLDA_SLEN: {   /* segment length */
-                    sym_ptr = *(id_table+id_table_base+
-                                ((struct vlda_slen *)vsym)->vslen_ident);
+                    sym_ptr = get_id(((struct vlda_slen *)vsym)->vslen_ident);
                     if (sym_ptr == 0)
                     {
                         sprintf(emsg,"Undefined segment indentifier %d used in \"%s\"",
@@ -1731,7 +1718,7 @@ void object( int fd )
                         int tsiz = MAX_TOKEN*8;
                         if (siz > tsiz) tsiz += siz;
                         token_pool_size = tsiz;
-                        token_pool = MEM_alloc(token_pool_size);
+                        token_pool = MEM_pool(token_pool_size);
                         misc_pool_used += token_pool_size;
                     }
                     strcpy(token_pool,inp_str+vdbgfile->name);
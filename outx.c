@@ -100,6 +100,8 @@ static  uint8_t   varcs;
 static  uint8_t   namcs;
 
 static char hexdig[] = "0123456789ABCDEF";
+static char hexpair[256][2];    /* each byte as two hex digits */
+static uint8_t nibsum[256];     /* sum of each byte's two nibbles */
 
 static VLDA_sym *vlda_sym;  /* pointer to line area */
 static VLDA_seg *vlda_seg;  /* pointer to segment definition */
@@ -107,13 +109,23 @@ static VLDA_abs *vlda_oline;
 static Sentinel *vlda_type;
 static MY_desc *vid;
 
+#define LINE_HEAD 8	/* room in front of each line buffer for put_rec() */
+
 static int formvar();
+static int to_image;		/* -IMAGE: text goes to image_put() */
 
 void outx_init( void )
 {
-    eline = MEM_alloc(MAX_LINE);
-    sline = MEM_alloc(MAX_LINE);
-    oline = MEM_alloc(MAX_LINE);
+    int i;
+    for (i = 0; i < 256; ++i)
+    {
+        hexpair[i][0] = hexdig[i >> 4];
+        hexpair[i][1] = hexdig[i & 0xF];
+        nibsum[i] = (i >> 4) + (i & 0xF);
+    }
+    eline = MEM_alloc(MAX_LINE+LINE_HEAD)+LINE_HEAD;
+    sline = MEM_alloc(MAX_LINE+LINE_HEAD)+LINE_HEAD;
+    oline = MEM_alloc(MAX_LINE+LINE_HEAD)+LINE_HEAD;
     vlda_sym = (VLDA_sym *)sline;
     vlda_seg = (VLDA_seg *)sline;
     vlda_oline = (VLDA_abs *)oline;
@@ -173,7 +185,31 @@ char *get_symid(SS_struct *sym_ptr, char *s)
     return(s);
 }
 
-static int16_t rsize,even_odd=0;
+/********************************************************************
+ * Write one binary record
+ */
+static void put_rec(FILE *fp, char *rec, int len)
+/*
+ * At entry:
+ *	fp - file to write to
+ *	rec - pointer to record. Must be the start of one of eline, sline
+ *		or oline, which have room in front for the record count.
+ *	len - number of bytes in record
+ * At exit:
+ *	record written. Except on VMS it is preceded by a 2 byte count
+ *	and padded to an even length, all with a single fwrite.
+ */
+{
+#ifndef VMS
+    int16_t rsize;
+
+    rsize = len;
+    rec -= sizeof(int16_t);
+    memcpy(rec,(char *)&rsize,sizeof(int16_t));
+    len += sizeof(int16_t)+(len&1);
+#endif
+    fwrite(rec,len,1,fp);
+}
 
 static char *outexp_vlda( EXP_stk *eptr, char *s, int *lp )
 {
@@ -427,12 +463,7 @@ char *outexp(EXP_stk *eptr, char *s, int tag, int32_t tlen, char *wrt, FILE *fp)
         }
         *len_ptr.vexp_len = len;          /* expression size (in items) */
         if (wrt==0) return(ve.vexp_chp); /* exit */
-#ifndef VMS
-        rsize = ve.vexp_chp-wrt;
-        fwrite((char *)&rsize,sizeof(int16_t),1,fp);
-        even_odd = rsize&1;
-#endif
-        fwrite(wrt,(int)(ve.vexp_chp-wrt)+even_odd,1,fp); /* write it */
+        put_rec(fp,wrt,ve.vexp_chp-wrt);
         return ve.vexp_chp;       /* exit */
     }
     else
@@ -483,6 +514,18 @@ char *outxfer( EXP_stk *exp, FILE *fp )
     return(0);
 }
 
+/*			outx_image()
+*	Select -IMAGE mode. From now until termobj(), outorg() and outbstr()
+*	just fill in the memory image and termobj() writes it out in address
+*	order with every record as full as it can be.
+*/
+void outx_image( void )
+{
+    to_image = 1;
+}
+
+static void outtext( const uint8_t *from, int len );
+
 /*			outbstr(from,len)
 *	Output a byte string, accumulating the checksums for the output record
 *	and both the even and odd ROMs. This routine converts each byte to two
@@ -490,18 +533,30 @@ char *outxfer( EXP_stk *exp, FILE *fp )
 */
 void outbstr( uint8_t *from, int len )
 {
-    register char *rop;
-    uint8_t c;
-    int  k,limit,toeol;
-    if (!qual_tbl[QUAL_VLDA].present)
+    int toeol;
+    if (to_image)
     {
-        len += len;       /* double the input length if ASCII output */
+        image_put(addr,from,len);
+        addr += len;
+        return;
     }
-    else
+    if (qual_tbl[QUAL_VLDA].present)
     {
         toeol = oline+ outx_width - op;
         if (len >= toeol-2) flushobj();
     }
+    outtext(from,len);
+}
+
+static void outtext( const uint8_t *from, int len )
+{
+    register char *rop;
+    unsigned int cs;
+    int  k,limit,toeol;
+    if (!qual_tbl[QUAL_VLDA].present)
+    {
+        len += len;       /* double the input length if ASCII output */
+    }
     while (len > 0)
     {
         if ( op != 0 )
@@ -555,24 +610,23 @@ void outbstr( uint8_t *from, int len )
         if (!qual_tbl[QUAL_VLDA].present)
         {
             addr += limit/2;       /* update address */
+            cs = objcs;
             for (  ; limit > 0 ; limit -= 2)
-            {  /* first transfer the high nibble */
+            {  /* two digits and their checksum at a time */
                 k = *from++;
-                c = k >> 4;
-                objcs += c;
-                *rop++ = hexdig[c];
-                c = k & 0xF;        /* now transfer the low one */
-                objcs += c;
-                *rop++ = hexdig[c];
+                rop[0] = hexpair[k][0];
+                rop[1] = hexpair[k][1];
+                rop += 2;
+                cs += nibsum[k];
             }              /* end for */    
+            objcs = cs;
         }
         else
         {
             addr += limit;
-            for (  ; limit > 0 ; --limit)
-            {
-                *rop++ = *from++;
-            }
+            memcpy(rop,from,limit);
+            rop += limit;
+            from += limit;
         }
         op = rop;
         if (maxop < op) maxop = op;
@@ -588,6 +642,11 @@ void outbstr( uint8_t *from, int len )
 void outorg( uint32_t address, EXP_stk *exp_ptr )
 {
     uint32_t taddr,laddr;       /* address of end of txt + 1 */
+    if (to_image)
+    {
+        addr = address;
+        return;
+    }
     switch (output_mode)
     {       /* how to encode it */
     case OUTPUT_HEX: {        /* absolute tekhex mode */
@@ -661,11 +720,10 @@ void outorg( uint32_t address, EXP_stk *exp_ptr )
 
 int outbyt( unsigned int num, char    *where )
 {
-    int chk;
-    chk = (num >> 4) &0xF;
-    *where++ = hexdig[chk];
-    *where = hexdig[num &= 0xF];
-    return(chk+num);
+    num &= 0xFF;
+    where[0] = hexpair[num][0];
+    where[1] = hexpair[num][1];
+    return(nibsum[num]);
 }
 
 
@@ -806,12 +864,7 @@ void outsym( SS_struct *sym_ptr, int mode )
         {
             *sp = '\r';
             *ssp = '\n';
-#ifndef VMS
-            rsize = ssp-sline+1;
-            fwrite((char *)&rsize,sizeof(int16_t),1,outxsym_fp);
-            even_odd = rsize&1;
-#endif
-            fwrite(sline,(int)(ssp-sline+1)+even_odd,1,outxsym_fp); /* write a transparent rcd */
+            put_rec(outxsym_fp,sline,ssp-sline+1);
         }
         else
         {
@@ -898,12 +951,7 @@ void outsym_def(SS_struct *sym_ptr, int mode )
                 vlda_sym->vsym_eoff = s - sline;
                 s = outexp(sym_ptr->ss_exprs,s,0,0l,(char *)0,(FILE *)0);   /* output the expression */
             }
-#ifndef VMS
-            rsize = s-sline;
-            fwrite((char *)&rsize,sizeof(int16_t),1,outxsym_fp);
-            even_odd = rsize&1;
-#endif
-            fwrite(sline,(int)(s-sline)+even_odd,1,outxsym_fp); /* write it */
+            put_rec(outxsym_fp,sline,s-sline);
             return;        /* done */
         }             /* --case 2,3 */
     }                /* --switch */
@@ -999,21 +1047,11 @@ void outseg_def(SS_struct *sym_ptr, uint32_t len, int based )
                 s -= 2;         /* eat it */
                 *s++ = 0;
             }
-#ifndef VMS
-            rsize = s-sline;
-            fwrite((char *)&rsize,sizeof(int16_t),1,outxsym_fp);
-            even_odd = rsize&1;
-#endif
-            fwrite(sline,(int)(s-sline)+even_odd,1,outxsym_fp); /* write it */
+            put_rec(outxsym_fp,sline,s-sline);
             ((VLDA_slen *)vlda_seg)->vslen_rectyp=VLDA_SLEN; /* signal its a GSD record */
             ((VLDA_slen *)vlda_seg)->vslen_ident = sym_ptr->ss_ident;
             ((VLDA_slen *)vlda_seg)->vslen_len = len; /* copy the length */
-#ifndef VMS
-            rsize = sizeof(VLDA_slen);
-            fwrite((char *)&rsize,sizeof(int16_t),1,outxsym_fp);
-            even_odd = rsize&1;
-#endif
-            fwrite(sline,sizeof(VLDA_slen)+even_odd,1,outxsym_fp); /* write it */
+            put_rec(outxsym_fp,sline,sizeof(VLDA_slen));
         }             /* --case 2,3 */
     }                /* --switch */
     return;          /* done */
@@ -1040,12 +1078,7 @@ void flushobj( void )
             }
         case OUTPUT_VLDA:
         case OUTPUT_OBJ: {
-#ifndef VMS
-                rsize = maxop-oline;
-                fwrite((char *)&rsize,sizeof(int16_t),1,outxabs_fp);
-                even_odd = rsize&1;
-#endif
-                fwrite(oline,(int)(maxop-oline)+even_odd,1,outxabs_fp);
+                put_rec(outxabs_fp,oline,maxop-oline);
                 break;
             }
         }
@@ -1070,12 +1103,7 @@ void flushsym( int mode)
         switch (mode)
         {
         case OUTPUT_VLDA: {
-#ifndef VMS
-                rsize = sp-sline;
-                fwrite((char *)&rsize,sizeof(int16_t),1,outxsym_fp);
-                even_odd = rsize&1;
-#endif
-                fwrite(sline,(int)(sp-sline)+even_odd,1,outxsym_fp); /* write it */
+                put_rec(outxsym_fp,sline,sp-sline);
                 break;
             }
         case OUTPUT_HEX: {
@@ -1093,8 +1121,30 @@ void flushsym( int mode)
 *	output.
 */
 
+/*			write_image()
+*	Write out the -IMAGE memory image, one run of stored bytes at a time.
+*/
+static void write_image( void )
+{
+    const uint8_t *from;
+    uint32_t where;
+    int len;
+
+    to_image = 0;
+    where = 0;
+    while ((from = image_run(&where,&len)) != 0)
+    {
+        outorg(where,(EXP_stk *)0);
+        outtext(from,len);
+        where += len;
+        if (where == 0) break;  /* ran off the top of memory */
+    }
+    image_free();
+}
+
 void termobj( int32_t traddr )
 {
+    if (to_image) write_image();
     if ( op ) flushobj();
     if (output_mode == OUTPUT_HEX)
     {
@@ -1116,12 +1166,7 @@ void termobj( int32_t traddr )
     {
         vlda_oline->vlda_type = VLDA_ABS;
         vlda_oline->vlda_addr = traddr;
-#ifndef VMS
-        rsize = sizeof(VLDA_abs);
-        fwrite((char *)&rsize,sizeof(int16_t),1,outxabs_fp);
-        even_odd = rsize&1;
-#endif
-        fwrite(oline,sizeof(VLDA_abs)+even_odd,1,outxabs_fp);
+        put_rec(outxabs_fp,oline,sizeof(VLDA_abs));
 #if 0
     }
     else if (qual_tbl[QUAL_REL].present)
@@ -1245,12 +1290,7 @@ void outid( FILE *fp, int mode )
             vldaid->vid_time = s - oline;
             strcpy(s,ascii_date);
             s += strlen(s)+1;
-#ifndef VMS
-            rsize = s-oline;
-            fwrite((char *)&rsize,sizeof(int16_t),1,fp);
-            even_odd = rsize&1;
-#endif
-            fwrite(oline,(int)(s-oline)+even_odd,1,fp);
+            put_rec(fp,oline,s-oline);
             return;
         }
     }
@@ -1274,12 +1314,7 @@ static int outtstcommon(char *asc, int alen, EXP_stk *exp, char *olcmd, int vlda
             strncpy(s,asc,alen);
             s += alen;
             *s++ = 0;
-#ifndef VMS
-            rsize = s-eline;
-            fwrite(&rsize,sizeof(int16_t),1,outxabs_fp);
-            even_odd = rsize&1;
-#endif
-            fwrite(eline,(int)(s-eline)+even_odd,1,outxabs_fp); /* write it */
+            put_rec(outxabs_fp,eline,s-eline);
             break;
         }
     case OUTPUT_OL: {
@@ -1346,12 +1381,7 @@ int out_dbgod( int mode, FILE *absfp, FN_struct *fnp )
         dbfp->version = s-eline;
         strcpy(s,fnp->od_version?fnp->od_version:"");
         s += strlen(s)+1;
-#ifndef VMS
-        rsize = s-eline;
-        fwrite(&rsize,sizeof(int16_t),1,absfp);
-        even_odd = rsize&1;
-#endif
-        fwrite(eline,(int)(s-eline)+even_odd,1,absfp); /* write it */
+        put_rec(absfp,eline,s-eline);
         if ((slp=fnp->od_seclist_top) != 0)
         {
             dbsp = (VLDA_dbgseg *)eline;
@@ -1381,12 +1411,7 @@ int out_dbgod( int mode, FILE *absfp, FN_struct *fnp )
                 s = (char *)(dbsp+1);
                 strcpy(s,ss->ss_string);
                 s += strlen(s)+1;
-                rsize = s-eline;
-#ifndef VMS
-                fwrite(&rsize,sizeof(int16_t),1,absfp);
-                even_odd = rsize&1;
-#endif
-                fwrite(eline,(int)rsize+even_odd,1,absfp); /* write it */
+                put_rec(absfp,eline,s-eline);
             } while ((slp=slp->next) != 0);
         }
     }
@@ -0,0 +1,308 @@
+/*
+    pack.c - Part of llf, a cross linker. Part of the macxx tool chain.
+    Copyright (C) 2008 David Shepperd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>		/* get standard I/O definitions */
+#include <stdlib.h>
+#include "token.h"		/* define compile time constants */
+#include "structs.h"		/* define structures */
+#include "header.h"
+
+/*
+ * Best fit decreasing packer for LOCATE ... FIT groups.
+ *
+ * pack_group() collects the segments of a FIT group, sorts them by size
+ * (largest first) and drops each one into the smallest free hole that
+ * will take it at its alignment. The holes come from the reserved memory
+ * list and are kept in bins by size (bin n holds holes of 2^n to
+ * 2^(n+1)-1 bytes), so finding the best hole only looks at the bins at
+ * or above the segment's size, stopping at the first bin with a fit.
+ *
+ * Holes are collected in address order starting at the group's base,
+ * at first until there is enough free space for the whole group, and
+ * then one more at a time whenever no hole collected so far will take
+ * the next segment. With a seg_maxlen, only holes below base+maxlen are
+ * used and all of them are collected up front. Each placement is added
+ * to the reserved memory list. Anything that doesn't fit is left for
+ * seg_fit() to place first fit as before; with a seg_maxlen that puts
+ * it past the TO limit, which seg_locate() reports as an error. The
+ * bytes packed and the free bytes in the space used are recorded in
+ * the group's seg_spec for the map.
+ */
+
+typedef struct pk_item {
+    SS_struct *pi_seg;		/* segment (or first of an overlaid run) */
+    uint32_t pi_len;		/* bytes needed */
+    uint32_t pi_align;		/* alignment mask */
+    int pi_order;		/* position in group (keeps the sort stable) */
+} PK_item;
+
+typedef struct pk_hole {
+    uint32_t ph_start;		/* first free address */
+    uint32_t ph_end;		/* first address past the hole */
+    int ph_next;		/* next hole in the bin (-1=end) */
+} PK_hole;
+
+#define PK_BINS 32
+
+static PK_item *pk_items;	/* segments to place */
+static int pk_items_size;
+static PK_hole *pk_holes;	/* hole pool */
+static int pk_holes_size, pk_holes_used, pk_holes_free;
+static int pk_bins[PK_BINS];	/* head of each size bin */
+static uint32_t pk_next;	/* where to look for the next hole */
+static uint32_t pk_limit;	/* don't collect holes at or above this */
+
+static int pk_bin( uint32_t size )
+{
+    int n = 0;
+    while (size >>= 1) ++n;
+    return n;
+}
+
+/**********************************************************************
+ * Add a hole to its bin
+ */
+static void pk_add_hole( uint32_t start, uint32_t end )
+{
+    int ii, bin;
+    if (end <= start) return;
+    if ((ii = pk_holes_free) >= 0)
+    {
+        pk_holes_free = pk_holes[ii].ph_next;
+    }
+    else
+    {
+        if (pk_holes_used >= pk_holes_size)
+        {
+            int old = pk_holes_size;
+            pk_holes_size = old ? 2*old : 64;
+            misc_pool_used += (pk_holes_size-old)*sizeof(PK_hole);
+            if (pk_holes)
+                pk_holes = (PK_hole *)MEM_realloc((char *)pk_holes, pk_holes_size*sizeof(PK_hole));
+            else
+                pk_holes = (PK_hole *)MEM_alloc(pk_holes_size*sizeof(PK_hole));
+        }
+        ii = pk_holes_used++;
+    }
+    bin = pk_bin(end-start);
+    pk_holes[ii].ph_start = start;
+    pk_holes[ii].ph_end = end;
+    pk_holes[ii].ph_next = pk_bins[bin];
+    pk_bins[bin] = ii;
+}
+
+/**********************************************************************
+ * Find the best hole for a segment and take the space out of it
+ */
+static int pk_best_fit(
+/*
+ * At entry:
+ */
+uint32_t len,			/* bytes needed (not 0) */
+uint32_t align,			/* alignment mask */
+uint32_t *where)		/* where to put the address chosen */
+/*
+ * At exit:
+ *	returns TRUE and the address in *where if a hole was found. The
+ *	leftover pieces of the hole are put back in their bins.
+ *	returns FALSE if no hole is big enough.
+ */
+{
+    int bin, ii, *prev, *best_prev=0, best=-1;
+    uint32_t a, size, best_size=0, best_a=0;
+
+    for (bin=pk_bin(len); bin < PK_BINS && best < 0; ++bin)
+    {
+        for (prev= &pk_bins[bin]; (ii = *prev) >= 0; prev = &pk_holes[ii].ph_next)
+        {
+            PK_hole *ph = pk_holes+ii;
+            a = (ph->ph_start+align)&~align;
+            if (a < ph->ph_start || a+len < a || a+len > ph->ph_end) continue;
+            size = ph->ph_end-ph->ph_start;
+            if (best < 0 || size < best_size ||
+                (size == best_size && ph->ph_start < pk_holes[best].ph_start))
+            {
+                best = ii;
+                best_prev = prev;
+                best_size = size;
+                best_a = a;
+            }
+        }
+    }
+    if (best < 0) return FALSE;
+    *best_prev = pk_holes[best].ph_next;	/* pull it out of its bin */
+    pk_holes[best].ph_next = pk_holes_free;
+    pk_holes_free = best;
+    a = pk_holes[best].ph_start;	/* (pk_add_hole() may reuse it) */
+    size = pk_holes[best].ph_end;
+    pk_add_hole(a, best_a);
+    pk_add_hole(best_a+len, size);
+    *where = best_a;
+    return TRUE;
+}
+
+/**********************************************************************
+ * Add the next hole above the ones already collected
+ */
+static int pk_more_holes( uint32_t *have )
+/*
+ * At entry:
+ *	have - pointer to count of free bytes collected so far
+ * At exit:
+ *	returns TRUE if a hole below pk_limit was added, else FALSE
+ */
+{
+    uint32_t start, end;
+    if (pk_next >= pk_limit || !get_free_hole(pk_next, &start, &end) || start >= pk_limit)
+    {
+        pk_next = pk_limit;
+        return FALSE;
+    }
+    if (end > pk_limit) end = pk_limit;
+    pk_add_hole(start, end);
+    *have += end-start;
+    if (*have < end-start) *have = 0xFFFFFFFFl;
+    pk_next = end;
+    return TRUE;
+}
+
+static int pk_compare( const void *a, const void *b )
+{
+    const PK_item *pa = (const PK_item *)a, *pb = (const PK_item *)b;
+    if (pa->pi_len != pb->pi_len) return pa->pi_len > pb->pi_len ? -1 : 1;
+    return pa->pi_order - pb->pi_order;
+}
+
+/**********************************************************************
+ * Pack the segments of a FIT group
+ */
+void pack_group(
+/*
+ * At entry:
+ */
+SS_struct *grp_nam,		/* pointer to group */
+SS_struct **ls,			/* pointer to group's list of segments */
+uint32_t bottom)		/* group's base address */
+/*
+ * At exit:
+ *	segments that were packed have sflg_packed set and their address
+ *	in seg_base, and that space is in the reserved memory list.
+ *	the group's seg_fill_used and seg_fill_free are updated.
+ */
+{
+    SS_struct *st, *ms;
+    SEG_spec_struct *seg_ptr, *grp_seg = grp_nam->seg_spec;
+    int ii, nitems = 0;
+    uint32_t need = 0, have = 0, top, used = 0, left = 0;
+
+    grp_seg->seg_fill_used = grp_seg->seg_fill_free = 0;
+    grp_seg->seg_fill_over = grp_seg->seg_fill_nover = 0;
+    while ((st = *ls++) != 0)
+    {
+        uint32_t len, align;
+        if (st == (struct ss_struct *)-2l) continue;
+        if (st == (struct ss_struct *)-1l)
+        {
+            ls = (struct ss_struct **)*ls;
+            continue;
+        }
+        ms = st;
+        len = align = 0;
+        while (1)
+        {
+            seg_ptr = ms->seg_spec;
+            seg_ptr->sflg_packed = 0;
+            if (!st->flg_ovr || len < seg_ptr->seg_len) len = seg_ptr->seg_len;
+            if (!st->flg_ovr || align < (1<<seg_ptr->seg_salign)-1) align = (1<<seg_ptr->seg_salign)-1;
+            if (!st->flg_ovr || !ms->flg_more)
+            {   /* an overlaid run is placed as one piece */
+                if (nitems >= pk_items_size)
+                {
+                    int old = pk_items_size;
+                    pk_items_size = old ? 2*old : 64;
+                    misc_pool_used += (pk_items_size-old)*sizeof(PK_item);
+                    if (pk_items)
+                        pk_items = (PK_item *)MEM_realloc((char *)pk_items, pk_items_size*sizeof(PK_item));
+                    else
+                        pk_items = (PK_item *)MEM_alloc(pk_items_size*sizeof(PK_item));
+                }
+                pk_items[nitems].pi_seg = st->flg_ovr ? st : ms;
+                pk_items[nitems].pi_len = len;
+                pk_items[nitems].pi_align = align;
+                pk_items[nitems].pi_order = nitems;
+                ++nitems;
+                need += len+align;
+                if (need < len) need = 0xFFFFFFFFl;
+            }
+            if (!ms->flg_more) break;
+            ms = ms->ss_next;
+        }
+    }
+    if (nitems == 0) return;
+    qsort(pk_items, nitems, sizeof(PK_item), pk_compare);
+
+/* Collect enough holes to start with */
+
+    for (ii=0; ii < PK_BINS; ++ii) pk_bins[ii] = -1;
+    pk_holes_used = 0;
+    pk_holes_free = -1;
+    pk_next = bottom;
+    pk_limit = 0xFFFFFFFFl;
+    if (grp_seg->seg_maxlen != 0 && bottom+grp_seg->seg_maxlen > bottom)
+        pk_limit = bottom+grp_seg->seg_maxlen;
+    while ((grp_seg->seg_maxlen != 0 || have < need) && pk_more_holes(&have));
+
+/* Largest first, each into the smallest hole it fits in */
+
+    top = bottom;
+    for (ii=0; ii < nitems; ++ii)
+    {
+        PK_item *pi = pk_items+ii;
+        uint32_t where;
+        int fit;
+        if (pi->pi_len == 0) continue;
+        while (!(fit=pk_best_fit(pi->pi_len, pi->pi_align, &where)) && pk_more_holes(&have));
+        if (!fit) continue;
+        add_to_reserve(where, pi->pi_len);
+        used += pi->pi_len;
+        if (top < where+pi->pi_len) top = where+pi->pi_len;
+        ms = pi->pi_seg;
+        while (1)
+        {
+            seg_ptr = ms->seg_spec;
+            seg_ptr->seg_base = where;
+            seg_ptr->sflg_packed = 1;
+            if (!pi->pi_seg->flg_ovr || !ms->flg_more) break;
+            ms = ms->ss_next;
+        }
+    }
+
+/* What's still free below the top of the packed area wasn't needed */
+
+    for (ii=0; ii < PK_BINS; ++ii)
+    {
+        int jj;
+        for (jj=pk_bins[ii]; jj >= 0; jj=pk_holes[jj].ph_next)
+        {
+            if (pk_holes[jj].ph_start < top)
+                left += (pk_holes[jj].ph_end < top ? pk_holes[jj].ph_end : top)-pk_holes[jj].ph_start;
+        }
+    }
+    grp_seg->seg_fill_used = used;
+    grp_seg->seg_fill_free = used+left;
+}
@@ -20,6 +20,11 @@
 #include <ctype.h>		/* get standard string type macros */
 #include <string.h>
 #include <errno.h>
+#if defined(M_UNIX)
+    #include <sys/types.h>
+    #include <sys/stat.h>
+    #include <sys/mman.h>
+#endif
 #include "token.h"		/* define compile time constants */
 #include "structs.h"		/* define structures */
 #include "header.h"		/* get our standard stuff */
@@ -30,7 +35,6 @@
 #define NULL 0
 
 #if 0
-extern int32_t id_table_size;
 extern FN_struct *xfer_fnd;
 extern struct fn_struct *get_fn_pool();
 #endif
@@ -71,8 +75,8 @@ SEG_spec_struct *get_seg_spec_mem( SS_struct *seg_ptr)
     {
         int t = sizeof(struct seg_spec_struct)*32;
         sym_pool_used += t;
-        seg_spec_pool = (struct seg_spec_struct *)MEM_alloc(t);
-        dbg_sec_pool = (DBG_seclist *)MEM_alloc(t);
+        seg_spec_pool = (struct seg_spec_struct *)MEM_pool(t);
+        dbg_sec_pool = (DBG_seclist *)MEM_pool(t);
         seg_spec_size = 31;
     }
     seg_ptr->flg_segment = 1;
@@ -95,6 +99,129 @@ SEG_spec_struct *get_seg_spec_mem( SS_struct *seg_ptr)
 
 int32_t record_count;
 
+/******************************************************************
+ * Memory mapped text input. When the input file can be mapped, the
+ * whole file is mapped privately (copy on write) and get_text() points
+ * inp_str directly at each line in the mapped image instead of copying
+ * it with fgets(). Each line is null terminated in place by borrowing
+ * the first byte of the following line, which is put back when the
+ * next line is fetched. The last line of the file (which has no
+ * following byte) is copied into the normal inp_str buffer.
+ */
+static char *text_map;          /* base of mapped file (0 if not mapped) */
+static char *text_end;          /* end of mapped file */
+static char *text_next;         /* start of next line in mapped file */
+static char *text_patch;        /* byte borrowed for the line's null */
+static char text_patch_chr;     /* original contents of that byte */
+static size_t text_map_size;    /* size of the mapping */
+static char *text_buff;         /* the real inp_str buffer */
+
+int map_text( FN_struct *fnd )
+/*
+ * At entry:
+ *	fnd - pointer to file descriptor of an opened text file
+ * At exit:
+ *	returns TRUE if the file has been mapped and get_text() will
+ *	read from the mapped image, FALSE if get_text() is to continue
+ *	to use fgets().
+ */
+{
+#if defined(M_UNIX)
+    struct stat st;
+    void *mp;
+    if (qual_tbl[QUAL_MMAP].negated) return(FALSE);
+    if (fstat(fileno(fnd->fn_file),&st) != 0 ||
+        !S_ISREG(st.st_mode) || st.st_size <= 0 ||
+        (off_t)(size_t)st.st_size != st.st_size)
+        return(FALSE);
+    mp = mmap(0,(size_t)st.st_size,PROT_READ|PROT_WRITE,MAP_PRIVATE,
+              fileno(fnd->fn_file),0);
+    if (mp == MAP_FAILED) return(FALSE);
+    text_map_size = (size_t)st.st_size;
+    text_next = text_map = (char *)mp;
+    text_end = text_map + text_map_size;
+    text_patch = 0;
+    text_buff = inp_str;
+    if (debug > 1)
+        printf("Mapped %lu bytes of %s\n",(unsigned long)text_map_size,fnd->fn_buff);
+    return(TRUE);
+#else
+    return(FALSE);
+#endif
+}
+
+void unmap_text( void )
+/*
+ * At entry:
+ *	no requirements
+ * At exit:
+ *	mapping (if any) is removed and inp_str points to its normal buffer.
+ */
+{
+#if defined(M_UNIX)
+    if (text_map != 0)
+    {
+        munmap(text_map,text_map_size);
+        text_map = text_end = text_next = text_patch = 0;
+        inp_ptr = inp_str = text_buff;
+        *inp_str = 0;
+    }
+#endif
+    return;
+}
+
+static int get_mapped_text( void )
+/*
+ * At entry:
+ *	text_map is non-zero.
+ * At exit:
+ *	inp_str and inp_ptr point to the next null terminated line.
+ *	returns EOF if there are no more lines, else TRUE.
+ */
+{
+    char *s,*e;
+    int len;
+    if (text_patch != 0)
+    {
+        *text_patch = text_patch_chr;   /* repair the previous line's null */
+        text_patch = 0;
+    }
+    s = text_next;
+    if (s >= text_end)
+    {
+        inp_ptr = inp_str = text_buff;
+        *inp_ptr = '\0';
+        return(EOF);
+    }
+    e = (char *)memchr(s,'\n',(size_t)(text_end-s));
+    if (e != 0 && e+1 < text_end)
+    {
+        text_patch = text_next = e+1;
+        text_patch_chr = *text_patch;
+        *text_patch = 0;
+        inp_ptr = inp_str = s;
+    }
+    else
+    {
+        len = (e != 0 ? e+1 : text_end) - s;
+        if (len+4 > inp_str_size)
+        {
+            inp_str_size = len+4+inp_str_size/2;
+            text_buff = (char *)MEM_realloc(text_buff,inp_str_size);
+        }
+        memcpy(text_buff,s,len);
+        if (e == 0)
+        {
+            text_buff[len++] = '\\';    /* same as fgets() path on an */
+            text_buff[len++] = '\n';     /* unterminated last line */
+        }
+        text_buff[len] = 0;
+        text_next = text_end;
+        inp_ptr = inp_str = text_buff;
+    }
+    return(1);
+}
+
 /******************************************************************
  * Pick up a line of text from the input file
  */
@@ -113,9 +240,16 @@ int get_text( void )
     if (token_pool_size <= MAX_TOKEN)
     {
         token_pool_size = MAX_TOKEN*8;     /* get a bunch of memory */
-        token_pool = MEM_alloc(token_pool_size); /* pick up some garbage area */
+        token_pool = MEM_pool(token_pool_size); /* pick up some garbage area */
         misc_pool_used += token_pool_size;
     }
+    if (text_map != 0)
+    {
+        if (get_mapped_text() == EOF) return(EOF);
+        record_count++;
+        if (option_input) puts_map(inp_str,-1);
+        return(1);
+    }
     s = inp_str;
     if (!fgets(inp_ptr=s,inp_str_size-3,current_fnd->fn_file))
     {
@@ -656,8 +790,8 @@ SS_struct *do_token_id( int flag, uint32_t *tableIndexP )
 #endif
    if (token_type == TOKEN_ID_num && !flag)
     {
-        tableIndex = id_table_base+token_value;
-        sym_ptr = id_table[tableIndex];
+        tableIndex = token_value;
+        sym_ptr = get_id(tableIndex);
         if (sym_ptr != 0 && sym_ptr->ss_fnd == current_fnd)
         {
             if (sym_ptr->flg_defined)
@@ -671,7 +805,7 @@ SS_struct *do_token_id( int flag, uint32_t *tableIndexP )
         }
         else
         {
-            id_table[tableIndex] = sym_ptr = get_symbol_block(1);
+            set_id(tableIndex,sym_ptr = get_symbol_block(1));
         }
         new_symbol = 1;
 		if ( tableIndexP )
@@ -704,18 +838,10 @@ SS_struct *do_token_id( int flag, uint32_t *tableIndexP )
 #endif
         switch (new_symbol)
         {
-        case 5: {      /* symbol added and is a duplicate (segment) */
-                sym_ptr->ss_string = first_symbol->ss_string;
-                token_value = 0;    /* pretend we have no string */
-            }          /* fall though to case 1,3 and 0 */
+        case 5:        /* symbol added and is a duplicate (segment) */
         case 1:        /* symbol is added */
         case 3: {      /* symbol is added, first in the hash table */
-                sym_ptr->ss_fnd = current_fnd;
-                if (token_value > 1)
-                {
-                    token_pool += token_value; /* update the free mem pointer */
-                    token_pool_size -= token_value;  /* and size */
-                }
+                sym_ptr->ss_fnd = current_fnd; /* name is in the arena, token_pool not kept */
             }
         case 0:  {     /* no symbol added */
                 if (qual_tbl[QUAL_CROSS].present)
@@ -739,22 +865,14 @@ SS_struct *do_token_id( int flag, uint32_t *tableIndexP )
     if (token_type == TOKEN_ID_num)
     {
 #if DEBUG_DO_TOKEN_ID
-      printf("do_token_id(): Found TOKEN_ID_num for symbol %s. flag=%d, token_value = %d, it_table_base=%d\n",
-          token_pool,flag,token_value, id_table_base);
+      printf("do_token_id(): Found TOKEN_ID_num for symbol %s. flag=%d, token_value = %d\n",
+          token_pool,flag,token_value);
 #endif
-        tableIndex = id_table_base+token_value;
-        if (tableIndex >= id_table_size)
+        tableIndex = token_value;
+        if ((sym_ptr = get_id(tableIndex)) == 0)
         {
             sym_ptr = get_symbol_block(1);
             insert_id(token_value,sym_ptr);
-        }
-        else
-        {
-            sym_ptr = id_table[tableIndex];
-            if (sym_ptr == 0)
-            {
-                id_table[tableIndex] = sym_ptr = get_symbol_block(1);
-            }
         }
 		if ( tableIndexP )
 			*tableIndexP = tableIndex;
@@ -1246,8 +1364,8 @@ int f1_abs(int flag)
         bad_token(tkn_ptr,"Expected an ID number here");
         return f1_eatit();
     }
-    tableIndex = id_table_base+token_value;
-    sym_ptr = id_table[tableIndex];
+    tableIndex = token_value;
+    sym_ptr = get_id(tableIndex);
     if (sym_ptr == 0 || sym_ptr->ss_fnd != current_fnd)
     {
         bad_token(tkn_ptr,"Expected segment ID here");
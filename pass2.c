@@ -16,20 +16,26 @@
 	along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#if defined(M_UNIX) && !defined(_POSIX_C_SOURCE)
+	#define _POSIX_C_SOURCE 200112L	/* for posix_madvise() */
+#endif
 #include <stdio.h>		/* get standard I/O definitions */
 #include <string.h>
 #include <errno.h>
-#include <string.h>
+#if defined(M_UNIX)
+	#include <sys/types.h>
+	#include <sys/mman.h>
+#endif
 #include "token.h"		/* define compile time constants */
 #include "structs.h"		/* define structures */
 #include "header.h"
 
 #include "vlda_structs.h"
+#include "exproper.h"
 
 static struct exp_stk tmp_expr;
 int32_t tmp_pool_used;
 static char *last_tmp_org;
-static int16_t tmp_length;
 
 #if !defined(INLINE)
 	#define INLINE
@@ -93,11 +99,413 @@ typedef struct tmp_struct
 
 static TmpStruct_t rtmp, *tmp_ptr;
 
-static TmpStruct_t *tmp_next, *tmp_top, *tmp_pool;
+static TmpStruct_t *tmp_next, *tmp_pool;
 static int tmp_pool_size;
 
+/********************************************************************
+ * The tmp stream is kept in segments of TMP_SEG_SIZE bytes (or a
+ * multiple of it if a single record needs more). Each segment ends
+ * with a TMP_LINK record. If -MEMLIMIT is given and the link grows
+ * past it, the finished segments are written to a spill file with
+ * one write each and their memory given back. pass2() reads them
+ * back one segment at a time, mapped straight from the spill file.
+ * With -PACK each segment is also run through sqz_block() as soon as
+ * it is finished and unpacked into tmp_unpack as pass2() gets to it.
+ */
+#define TMP_SEG_SIZE (64*1024)
+
+typedef struct tmp_seg
+{
+	char *sg_mem;		/* segment in memory (0 if spilled) */
+	long sg_off;		/* offset in spill file */
+	int32_t sg_size;	/* size of segment in bytes */
+	int32_t sg_used;	/* bytes in use (through the TMP_LINK) */
+	int32_t sg_zsize;	/* size once packed (0 if not packed) */
+	int sg_mapped;		/* sg_mem is a mapping of the spill file */
+} TmpSeg_t;
+
+static TmpSeg_t *tmp_segs;	/* all the segments in order */
+static int tmp_nsegs;		/* number of segments in use */
+static int tmp_segs_size;	/* number of entries in tmp_segs */
+static int tmp_cur_seg;		/* segment being read by pass2 */
+static FILE *spill_fp;		/* spill file (0 if none yet) */
+static long spill_end;		/* next free offset in spill file */
+int32_t tmp_spill_used;		/* bytes written to the spill file */
+static char *tmp_zbuf;		/* scratch for packed segments */
+static int32_t tmp_zbuf_size;
+static char *tmp_unpack;	/* unpacked copy of the segment being read */
+static int32_t tmp_unpack_size;
+
+/********************************************************************
+ * Where each TMP_ORG record is in the tmp stream. put_tmp() adds an
+ * entry as each one is written, so pass2() can find the runs ahead
+ * of where it is reading and hand them out to worker threads.
+ */
+typedef struct tmp_org
+{
+	int to_seg;			/* tmp segment holding the record */
+	int32_t to_off;		/* offset of the record in the segment */
+} TmpOrg_t;
+
+static TmpOrg_t *tmp_orgs;	/* all the TMP_ORG records in order */
+static int tmp_norgs;		/* number of them */
+static int tmp_orgs_size;	/* number of entries in tmp_orgs */
+
 static SS_struct *last_segment = 0;
 
+#define FX_STACK 16		/* deepest expression the fast evaluator will take */
+
+/********************************************************************
+ * Tell how many stack items an operator uses. Only the operators
+ * that oper_fold() knows how to do are recognised.
+ */
+static int oper_arity(int32_t oper)
+/*
+ * At entry:
+ *	oper - EXPR_OPER token's value
+ * At exit:
+ *	returns 1 or 2 for the number of items it takes from the stack
+ *	or 0 if it is something that has to be left to ev_exp().
+ */
+{
+	switch (oper)
+	{
+	case EXPROPER_COM:
+	case EXPROPER_NEG:
+	case EXPROPER_SWAP:
+	case (EXPROPER_TST_NOT << 8) | EXPROPER_TST:
+		return 1;
+	case EXPROPER_ADD:
+	case EXPROPER_SUB:
+	case EXPROPER_MUL:
+	case EXPROPER_DIV:
+	case EXPROPER_USD:
+	case EXPROPER_MOD:
+	case EXPROPER_AND:
+	case EXPROPER_OR:
+	case EXPROPER_XOR:
+	case EXPROPER_SHL:
+	case EXPROPER_SHR:
+	case (EXPROPER_TST_AND << 8) | EXPROPER_TST:
+	case (EXPROPER_TST_OR << 8) | EXPROPER_TST:
+	case (EXPROPER_TST_LT << 8) | EXPROPER_TST:
+	case (EXPROPER_TST_GT << 8) | EXPROPER_TST:
+	case (EXPROPER_TST_EQ << 8) | EXPROPER_TST:
+	case (EXPROPER_TST_NE << 8) | EXPROPER_TST:
+	case (EXPROPER_TST_LE << 8) | EXPROPER_TST:
+	case (EXPROPER_TST_GE << 8) | EXPROPER_TST:
+		return 2;
+	}
+	return 0;
+}
+
+/********************************************************************
+ * Apply an operator to absolute values, exactly as ev_exp() would.
+ */
+static int oper_fold(int32_t oper, int32_t *fos)
+/*
+ * At entry:
+ *	oper - EXPR_OPER token's value
+ *	fos - points to top of a stack of values. fos[-1] is the
+ *		second item if the operator takes two.
+ * At exit:
+ *	returns the number of items consumed (the result is left in
+ *	the lowest of them) or 0 if nothing was done, either because
+ *	oper_arity() doesn't know the operator or because ev_exp()
+ *	would have complained about it (divide by 0).
+ */
+{
+	int32_t v;
+
+	switch (oper)
+	{
+	case EXPROPER_COM:
+		*fos = ~*fos;
+		return 1;
+	case EXPROPER_NEG:
+		*fos = -*fos;
+		return 1;
+	case EXPROPER_SWAP:
+		*fos = ((*fos >> 8) & 0x00FF00FF) | ((*fos & 0x00FF00FF) << 8);
+		return 1;
+	case (EXPROPER_TST_NOT << 8) | EXPROPER_TST:
+		*fos = (*fos == 0);
+		return 1;
+	}
+	if ( !oper_arity(oper) )
+		return 0;
+	v = *fos--;
+	switch (oper)
+	{
+	case EXPROPER_ADD:
+		*fos += v;
+		break;
+	case EXPROPER_SUB:
+		*fos -= v;
+		break;
+	case EXPROPER_MUL:
+		*fos *= v;
+		break;
+	case EXPROPER_DIV:
+		if ( v == 0 )
+			return 0;
+		*fos /= v;
+		break;
+	case EXPROPER_USD:
+		if ( v == 0 )
+			return 0;
+		*fos = (uint32_t)*fos / (uint32_t)v;
+		break;
+	case EXPROPER_MOD:
+		if ( v == 0 )
+			return 0;
+		*fos %= v;
+		break;
+	case EXPROPER_AND:
+		*fos &= v;
+		break;
+	case EXPROPER_OR:
+		*fos |= v;
+		break;
+	case EXPROPER_XOR:
+		*fos ^= v;
+		break;
+	case EXPROPER_SHL:
+		*fos = (v > 31 || v < 0) ? 0 : *fos << v;
+		break;
+	case EXPROPER_SHR:
+		*fos = (v > 31 || v < 0) ? 0 : (int32_t)((uint32_t)*fos >> v);
+		break;
+	case (EXPROPER_TST_AND << 8) | EXPROPER_TST:
+		*fos = (*fos != 0) & (v != 0);
+		break;
+	case (EXPROPER_TST_OR << 8) | EXPROPER_TST:
+		*fos = (*fos != 0) | (v != 0);
+		break;
+	case (EXPROPER_TST_LT << 8) | EXPROPER_TST:
+		*fos = (*fos < v);
+		break;
+	case (EXPROPER_TST_GT << 8) | EXPROPER_TST:
+		*fos = (*fos > v);
+		break;
+	case (EXPROPER_TST_EQ << 8) | EXPROPER_TST:
+		*fos = (*fos == v);
+		break;
+	case (EXPROPER_TST_NE << 8) | EXPROPER_TST:
+		*fos = (*fos != v);
+		break;
+	case (EXPROPER_TST_LE << 8) | EXPROPER_TST:
+		*fos = (*fos <= v);
+		break;
+	case (EXPROPER_TST_GE << 8) | EXPROPER_TST:
+		*fos = (*fos >= v);
+		break;
+	}
+	return 2;
+}
+
+/********************************************************************
+ * Compile an expression for the fast evaluator. Most of the
+ * expressions in the tmp stream are just a symbol or two and a
+ * constant glued together with +, - or >>, and they need none of
+ * the relocation or error handling that ev_exp() provides. This
+ * checks the expression once, when it goes into the tmp stream,
+ * and records how deep a stack it needs. The result is kept in
+ * the record's tf_tag.
+ */
+static int compile_expr(EXPR_token *exp, int32_t len)
+/*
+ * At entry:
+ *	exp - pointer to expression tokens
+ *	len - number of tokens
+ * At exit:
+ *	returns the stack depth the expression needs if fast_expr()
+ *	can evaluate it, else returns 0.
+ */
+{
+	int depth = 0, deepest = 0, k;
+
+	for (; len > 0; --len, ++exp)
+	{
+		switch (exp->expr_code)
+		{
+		case EXPR_SYM:
+		case EXPR_VALUE:
+			if ( ++depth > deepest )
+			{
+				if ( depth > FX_STACK )
+					return 0;
+				deepest = depth;
+			}
+			continue;
+		case EXPR_OPER:
+			if ( (k = oper_arity(exp->expr_value)) == 0 || depth < k )
+				return 0;   /* anything else goes the long way */
+			depth -= k - 1;
+			continue;
+		}
+		return 0;
+	}
+	return (depth == 1) ? deepest : 0;
+}
+
+/********************************************************************
+ * Evaluate a compiled expression. Only absolute output is handled;
+ * if any symbol is undefined or still has an unresolved definition
+ * FALSE is returned so the caller can hand the expression to
+ * evaluate_expression() for the proper diagnostics. Nothing global
+ * is touched, so the pass 2 workers use this directly.
+ */
+static int fx_eval(EXPR_token *exp, int32_t len, int depth, int32_t *value, SS_struct **seg_ref)
+/*
+ * At entry:
+ *	exp - pointer to expression tokens
+ *	len - number of tokens
+ *	depth - value returned by compile_expr() for this expression
+ *	value - where to put the result
+ *	seg_ref - set to each segment the expression refers to
+ * At exit:
+ *	returns TRUE if the expression was evaluated.
+ */
+{
+	int32_t stk[FX_STACK];
+	int sp;
+	SS_struct *sym_ptr;
+
+	if ( depth <= 0 || qual_tbl[QUAL_REL].present )
+		return FALSE;
+	sp = -1;
+	for (; len > 0; --len, ++exp)
+	{
+		if ( exp->expr_code == EXPR_VALUE )
+		{
+			stk[++sp] = exp->expr_value;
+			continue;
+		}
+		if ( exp->expr_code == EXPR_OPER )
+		{
+			switch (oper_fold(exp->expr_value, stk + sp))
+			{
+			case 0:
+				return FALSE;
+			case 2:
+				--sp;
+			}
+			continue;
+		}
+		sym_ptr = exp->ss_ptr;
+		if ( !sym_ptr->flg_defined )
+			return FALSE;
+		if ( sym_ptr->flg_segment )
+			*seg_ref = sym_ptr;
+		else if ( sym_ptr->flg_exprs )
+			return FALSE;
+		stk[++sp] = exp->expr_value + sym_ptr->ss_value;
+	}
+	*value = stk[0];
+	return TRUE;
+}
+
+/********************************************************************
+ * Evaluate a compiled expression for pass2()
+ */
+static int fast_expr(EXP_stk *eptr, int depth)
+/*
+ * At entry:
+ *	eptr - points to exp_stk containing expression stats
+ *	depth - value returned by compile_expr() for this expression
+ * At exit:
+ *	returns TRUE if the expression was evaluated. The expression
+ *	is collapsed to a single EXPR_VALUE and the result is also
+ *	in token_value, as evaluate_expression() would have left it.
+ *	Otherwise the expression is untouched.
+ */
+{
+	int32_t value;
+	EXPR_token *exp;
+
+	if ( !fx_eval(eptr->ptr, eptr->len, depth, &value, &last_seg_ref) )
+		return FALSE;
+	exp = eptr->ptr;
+	exp->expr_code = EXPR_VALUE;
+	exp->expr_value = token_value = value;
+	expr_stack_ptr = eptr->len = 1;
+	return TRUE;
+}
+
+/********************************************************************
+ * Fold an expression as far as it can be at the end of its file.
+ * Terms that are absolute symbols become values, operators with
+ * only values under them are done, and for absolute output a
+ * constant added to or subtracted from a segment is carried in the
+ * segment's term (which is where ev_exp() puts it anyway). Segments
+ * and groups don't have their values until seg_locate(), so they
+ * are left as symbols. A constant is not carried into any other
+ * symbol: if that symbol fails to resolve, ev_exp() replaces its
+ * term with 0 and the constant has to survive as a term of its own.
+ */
+static int32_t fold_expr(EXPR_token *exp, int32_t len)
+/*
+ * At entry:
+ *	exp - pointer to expression tokens with the ID's already bound
+ *	len - number of tokens
+ * At exit:
+ *	expression rewritten in place. Returns the new number of tokens.
+ */
+{
+	EXPR_token *out, *top;
+	SS_struct *sym_ptr;
+	int32_t val[2];
+	int32_t oper;
+	int k;
+
+	top = out = exp;
+	for (; len > 0; --len, ++exp, ++out)
+	{
+		if ( out != exp )
+			*out = *exp;
+		if ( out->expr_code == EXPR_SYM )
+		{
+			sym_ptr = out->ss_ptr;
+			if ( sym_ptr->flg_defined && !sym_ptr->flg_segment && !sym_ptr->flg_group
+				 && !sym_ptr->flg_exprs )
+			{
+				out->expr_code = EXPR_VALUE;
+				out->expr_value += sym_ptr->ss_value;
+			}
+			continue;
+		}
+		if ( out->expr_code != EXPR_OPER )
+			continue;
+		oper = out->expr_value;
+		k = oper_arity(oper);
+		if ( k == 0 || out - top < k || out[-1].expr_code != EXPR_VALUE )
+			continue;
+		if ( k == 1 || out[-2].expr_code == EXPR_VALUE )
+		{
+			val[1] = out[-1].expr_value;
+			if ( k == 2 )
+				val[0] = out[-2].expr_value;
+			if ( oper_fold(oper, val + 1) != k )
+				continue;
+			out -= k;
+			out->expr_value = val[2 - k];
+			continue;
+		}
+		if ( !qual_tbl[QUAL_REL].present && out[-2].expr_code == EXPR_SYM
+			 && out[-2].ss_ptr->flg_defined && out[-2].ss_ptr->flg_segment
+			 && (oper == EXPROPER_ADD || oper == EXPROPER_SUB) )
+		{
+			out -= 2;
+			if ( oper == EXPROPER_ADD )
+				out->expr_value += out[1].expr_value;
+			else
+				out->expr_value -= out[1].expr_value;
+		}
+	}
+	return out - top;
+}
+
 char *sqz_it(char *src, int typ, int32_t cnt, int siz)
 {
 	union
@@ -471,15 +879,262 @@ char* unsqz_it(char *src)
 					}        /* -- case */
 				}           /* -- switch expr_code */
 			}          /* -- for() expr */
+			if ( rtmp.tf_type == TMP_EXPR )
+				rtmp.tf_tag = compile_expr(tmp_expr.ptr, rtmp.tfLength);
 		}             /* -- case TMP_EXPR */
 	}                /* -- switch TMP_TYPE */
 	return (sqz.b8);
 }
 
+/********************************************************************
+ * Write the finished tmp segments to the spill file
+ */
+static void spill_tmp(void)
+/*
+ * At entry:
+ *	all the segments in tmp_segs are complete (end in TMP_LINK)
+ * At exit:
+ *	any of them that were in memory are in the spill file instead
+ *	and their memory has been freed.
+ */
+{
+	TmpSeg_t *seg;
+	int ii;
+
+	if ( spill_fp == 0 )
+	{
+		if ( (spill_fp = tmpfile()) == 0 )
+		{
+			sprintf(emsg, "Unable to create a tmp file to hold the tmp stream: %s",
+					err2str(errno));
+			err_msg(MSG_FATAL, emsg);
+			EXIT_FALSE;
+		}
+		spill_end = 0;
+	}
+	for (ii = 0, seg = tmp_segs; ii < tmp_nsegs; ++ii, ++seg)
+	{
+		int32_t size;
+		if ( seg->sg_mem == 0 )
+			continue;
+		if ( (size = seg->sg_zsize) == 0 )
+		{
+			size = seg->sg_size;    /* mapped back, so needs to be page aligned */
+			spill_end = (spill_end + TMP_SEG_SIZE - 1) & ~(TMP_SEG_SIZE - 1);
+		}
+		if ( fseek(spill_fp, spill_end, SEEK_SET)
+			 || fwrite(seg->sg_mem, size, 1, spill_fp) != 1 )
+		{
+			sprintf(emsg, "Error writing %d bytes to the tmp stream's spill file: %s",
+					size, err2str(errno));
+			err_msg(MSG_FATAL, emsg);
+			EXIT_FALSE;
+		}
+		seg->sg_off = spill_end;
+		spill_end += size;
+		tmp_spill_used += size;
+		MEM_free(seg->sg_mem);
+		seg->sg_mem = 0;
+	}
+}
+
+/********************************************************************
+ * Get room in one of the scratch buffers
+ */
+static char *tmp_scratch(char **buf, int32_t *size, int32_t need)
+{
+	if ( *size < need )
+	{
+		if ( *buf )
+			MEM_free(*buf);
+		*buf = MEM_alloc(need);
+		misc_pool_used += need - *size;
+		*size = need;
+	}
+	return *buf;
+}
+
+/********************************************************************
+ * Pack a finished tmp segment
+ */
+static void pack_tmp_seg(TmpSeg_t *seg)
+/*
+ * At entry:
+ *	seg - segment that ends in TMP_LINK with sg_used set
+ * At exit:
+ *	segment replaced with its packed form unless that would not
+ *	be any smaller.
+ */
+{
+	char *zp;
+	int32_t zsize;
+
+	zp = tmp_scratch(&tmp_zbuf, &tmp_zbuf_size, sqz_bound(seg->sg_size));
+	zsize = sqz_block(seg->sg_mem, seg->sg_used, zp);
+	if ( zsize >= seg->sg_used )
+		return;
+	MEM_free(seg->sg_mem);
+	seg->sg_mem = MEM_alloc(zsize);
+	memcpy(seg->sg_mem, zp, zsize);
+	seg->sg_zsize = zsize;
+	tmp_pool_used -= seg->sg_size - zsize;
+}
+
+/********************************************************************
+ * Start a new tmp segment
+ */
+static void new_tmp_seg(int32_t size)
+/*
+ * At entry:
+ *	size - minimum number of bytes needed
+ * At exit:
+ *	tmp_pool points to a new segment of at least size bytes. If
+ *	that would put the link over its -MEMLIMIT, the segments
+ *	before it have been spilled first.
+ */
+{
+	TmpSeg_t *seg;
+
+	size = (size + TMP_SEG_SIZE - 1) & ~(TMP_SEG_SIZE - 1);
+	if ( size < TMP_SEG_SIZE )
+		size = TMP_SEG_SIZE;
+	if ( tmp_nsegs )
+	{
+		seg = tmp_segs + tmp_nsegs - 1;
+		seg->sg_used = (char *)tmp_pool + sizeof(TmpStruct_t) - seg->sg_mem;
+		if ( qual_tbl[QUAL_PACK].present )
+			pack_tmp_seg(seg);
+	}
+	if ( qual_tbl[QUAL_MEMLIMIT].present && tmp_nsegs
+		 && total_mem_used + size > qual_tbl[QUAL_MEMLIMIT].valueInt * 1024 )
+		spill_tmp();
+	if ( tmp_nsegs >= tmp_segs_size )
+	{
+		int nsiz = tmp_segs_size ? tmp_segs_size * 2 : 64;
+		if ( tmp_segs )
+			tmp_segs = (TmpSeg_t *)MEM_realloc(tmp_segs, nsiz * sizeof(TmpSeg_t));
+		else
+			tmp_segs = (TmpSeg_t *)MEM_alloc(nsiz * sizeof(TmpSeg_t));
+		misc_pool_used += (nsiz - tmp_segs_size) * sizeof(TmpSeg_t);
+		tmp_segs_size = nsiz;
+	}
+	seg = tmp_segs + tmp_nsegs++;
+	seg->sg_mem = MEM_alloc(size);
+	seg->sg_off = -1;
+	seg->sg_size = size;
+	seg->sg_used = size;
+	seg->sg_zsize = 0;
+	seg->sg_mapped = 0;
+	tmp_pool_used += size;
+	tmp_pool = (TmpStruct_t *)seg->sg_mem;
+	tmp_pool_size = size;
+}
+
+/********************************************************************
+ * Get a tmp segment back for reading
+ */
+static TmpStruct_t *load_tmp_seg(int idx)
+/*
+ * At entry:
+ *	idx - index of segment to load
+ * At exit:
+ *	returns pointer to the segment's first record
+ */
+{
+	TmpSeg_t *seg;
+
+	if ( idx >= tmp_nsegs )
+	{
+		err_msg(MSG_FATAL, "Internal error: Ran off the end of the tmp stream");
+		EXIT_FALSE;
+	}
+	seg = tmp_segs + idx;
+	if ( seg->sg_zsize )
+	{
+		char *zp;
+		zp = seg->sg_mem;
+		if ( zp == 0 )
+		{
+			zp = tmp_scratch(&tmp_zbuf, &tmp_zbuf_size, seg->sg_zsize);
+			if ( fseek(spill_fp, seg->sg_off, SEEK_SET)
+				 || fread(zp, seg->sg_zsize, 1, spill_fp) != 1 )
+			{
+				sprintf(emsg, "Error reading %d bytes from the tmp stream's spill file: %s",
+						seg->sg_zsize, err2str(errno));
+				err_msg(MSG_FATAL, emsg);
+				EXIT_FALSE;
+			}
+		}
+		tmp_scratch(&tmp_unpack, &tmp_unpack_size, seg->sg_used);
+		if ( unsqz_block(zp, seg->sg_zsize, tmp_unpack, seg->sg_used) != seg->sg_used )
+		{
+			sprintf(emsg, "Internal error: tmp segment %d did not unpack", idx);
+			err_msg(MSG_FATAL, emsg);
+			EXIT_FALSE;
+		}
+		return (TmpStruct_t *)tmp_unpack;
+	}
+	if ( seg->sg_mem == 0 )
+	{
+#if defined(M_UNIX)
+		void *mp;
+		mp = mmap(0, (size_t)seg->sg_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+				  fileno(spill_fp), (off_t)seg->sg_off);
+		if ( mp != MAP_FAILED )
+		{
+			posix_madvise(mp, (size_t)seg->sg_size, POSIX_MADV_SEQUENTIAL);
+			seg->sg_mem = (char *)mp;
+			seg->sg_mapped = 1;
+		}
+		else
+#endif
+		{
+			seg->sg_mem = MEM_alloc(seg->sg_size);
+			if ( fseek(spill_fp, seg->sg_off, SEEK_SET)
+				 || fread(seg->sg_mem, seg->sg_size, 1, spill_fp) != 1 )
+			{
+				sprintf(emsg, "Error reading %d bytes from the tmp stream's spill file: %s",
+						seg->sg_size, err2str(errno));
+				err_msg(MSG_FATAL, emsg);
+				EXIT_FALSE;
+			}
+		}
+	}
+	return (TmpStruct_t *)seg->sg_mem;
+}
+
+/********************************************************************
+ * Done reading a tmp segment
+ */
+static void drop_tmp_seg(int idx)
+{
+	TmpSeg_t *seg;
+
+	seg = tmp_segs + idx;
+	if ( seg->sg_mem == 0 )
+		return;
+#if defined(M_UNIX)
+	if ( seg->sg_mapped )
+		munmap(seg->sg_mem, (size_t)seg->sg_size);
+	else
+#endif
+	{
+		int ferr;
+		if ( (ferr = MEM_free(seg->sg_mem)) )
+		{ /* give back the memory */
+			sprintf(emsg, "Error (%08X) free'ing %d bytes at %p from tmp_pool",
+					ferr, seg->sg_size, (void *)seg->sg_mem);
+			err_msg(MSG_WARN, emsg);
+		}
+	}
+	seg->sg_mem = 0;
+	seg->sg_mapped = 0;
+}
+
 /********************************************************************
  * Write a bunch of data to the temp file
  */
-void write_to_tmp(int typ, int32_t itm_cnt, char *itm_ptr, int itm_siz)
+static void put_tmp(int typ, int32_t itm_cnt, char *itm_ptr, int itm_siz)
 /*
  * At entry:
  *	typ - TMP_xxx value id'ing the block data
@@ -507,31 +1162,21 @@ void write_to_tmp(int typ, int32_t itm_cnt, char *itm_ptr, int itm_siz)
 	if ( !output_files[OUT_FN_ABS].fn_present )
 		return; /* nuthin' to do if no ABS wanted */
 	if ( tmp_pool_size == 0 )
-	{
-		tmp_pool_size = MAX_TOKEN * 8;      /* get some memory */
-		tmp_pool_used += MAX_TOKEN * 8;
-		tmp_pool = (TmpStruct_t *)MEM_alloc(tmp_pool_size);
-		tmp_top = tmp_pool;       /* remember where the top starts */
-	}
+		new_tmp_seg(0);         /* get some memory */
 	tmp.t = tmp_pool;
 	itz = (typ == TMP_TAG) ? 0 : itm_cnt * itm_siz;
 	itz += ALIGN(itz);
-	if ( tmp_fp == 0 )
 	{
 		int tsiz;
 		tsiz = 2 * sizeof(TmpStruct_t) + itz;
 		if ( tmp_pool_size < tsiz )
 		{
-			if ( tsiz < MAX_TOKEN * 8 )
-				tsiz = MAX_TOKEN * 8;
-			tmp.t->tf_type = TMP_LINK; /* link to a new area */
-			tmp.t->tfLink = (TmpStruct_t *)MEM_alloc(tsiz);
-			tmp_pool_used += tsiz;
-			tmp_pool_size = tsiz;
-			tmp_pool = tmp.t->tfLink;
+			tmp.t->tf_type = TMP_LINK; /* link to the next segment */
+			tmp.t->tfLink = NULL;
+			new_tmp_seg(tsiz);
 #if defined(DEBUG_LINK)
-			printf("Writing TMP_LINK at %p, align=%" FMT_PTRDIF_PRFX "d. New pool at %p, align=%d\n",
-				   (void *)tmp.t, (tmp.t & 3), (void *)tmp_pool, (tmp_pool & 3));
+			printf("Writing TMP_LINK at %p. New segment %d at %p\n",
+				   (void *)tmp.t, tmp_nsegs - 1, (void *)tmp_pool);
 #endif
 			tmp.t = tmp_pool;
 			last_tmp_org = NULL;
@@ -547,6 +1192,19 @@ void write_to_tmp(int typ, int32_t itm_cnt, char *itm_ptr, int itm_siz)
 			else
 			{
 				last_tmp_org = tmp.c;
+				if ( tmp_norgs >= tmp_orgs_size )
+				{
+					int nsiz = tmp_orgs_size ? tmp_orgs_size * 2 : 256;
+					if ( tmp_orgs )
+						tmp_orgs = (TmpOrg_t *)MEM_realloc(tmp_orgs, nsiz * sizeof(TmpOrg_t));
+					else
+						tmp_orgs = (TmpOrg_t *)MEM_alloc(nsiz * sizeof(TmpOrg_t));
+					misc_pool_used += (nsiz - tmp_orgs_size) * sizeof(TmpOrg_t);
+					tmp_orgs_size = nsiz;
+				}
+				tmp_orgs[tmp_norgs].to_seg = tmp_nsegs - 1;
+				tmp_orgs[tmp_norgs].to_off = tmp.c - tmp_segs[tmp_nsegs - 1].sg_mem;
+				++tmp_norgs;
 			}
 		}
 		else
@@ -557,7 +1215,9 @@ void write_to_tmp(int typ, int32_t itm_cnt, char *itm_ptr, int itm_siz)
 		{
 			tmp.t->tf_type = typ;      /* set the type */
 			tmp.t->tfLength = itm_cnt;    /* set the item count */
-			if ( itm_ptr != (char *)0 )
+			if ( typ == TMP_EXPR )
+				tmp.t->tf_tag = compile_expr((EXPR_token *)itm_ptr, itm_cnt);
+			else if ( itm_ptr != (char *)0 )
 				tmp.t->tf_tag = *itm_ptr;    /* in case type is tag */
 			dst.t = tmp.t + 1;
 			src.c = itm_ptr;
@@ -583,182 +1243,291 @@ void write_to_tmp(int typ, int32_t itm_cnt, char *itm_ptr, int itm_siz)
 		tmp_pool_size -= dst.c - tmp.c;
 		tmp_pool = dst.t;             /* update pointer */
 	}
-	else
-	{
-		int t;
-		dst.c = sqz_it(itm_ptr, typ, itm_cnt, itm_siz);
-		tmp_length = dst.c - (char *)tmp_top;
-		t = fwrite((char *)&tmp_length, sizeof(tmp_length), 1, tmp_fp);
-		if ( t != 1 )
-		{
-			sprintf(emsg, "Error fwrite'ing %d bytes (1 elem) to \"%s\", wrote %d: %s",
-					(int)sizeof(tmp_length), output_files[OUT_FN_TMP].fn_buff,
-					(int)(t * sizeof(tmp_length)), err2str(errno));
-			err_msg(MSG_FATAL, emsg);
-			EXIT_FALSE;
-		}
-		t = fwrite((char *)tmp_top, (int)tmp_length, 1, tmp_fp);
-		if ( t != 1 )
-		{
-			sprintf(emsg, "Error fwrite'ing %d bytes (1 elem) to \"%s\", wrote %d: %s",
-					tmp_length, output_files[OUT_FN_TMP].fn_buff,
-					t * tmp_length, err2str(errno));
-			err_msg(MSG_FATAL, emsg);
-			EXIT_FALSE;
-		}
-	}
 	return;
 }
 
-/**********************************************************************
- * Read a bunch of data from tmp file
+/********************************************************************
+ * The records for the file being read are held here until the end
+ * of the file, when all the ID's it used are known. They are then
+ * bound to their symbols, folded and sent on to put_tmp(). Nothing
+ * in the tmp stream refers to the ID table after that.
  */
-int read_from_tmp(void)
+typedef struct tmp_stage
+{
+	int ts_type;		/* TMP_xxx code */
+	int ts_siz;			/* size of each item */
+	int32_t ts_cnt;		/* number of items */
+	int32_t ts_bytes;	/* bytes of data following (rounded up) */
+} TmpStage_t;
+
+static char *stage_buf;
+static int32_t stage_size, stage_used;
+
+/********************************************************************
+ * Write a bunch of data to the temp file
+ */
+void write_to_tmp(int typ, int32_t itm_cnt, char *itm_ptr, int itm_siz)
 /*
  * At entry:
+ *	typ - TMP_xxx value id'ing the block data
+ *	itm_cnt - number of items to write
+ *	itm_ptr - pointer to items to write (or tag character)
+ *	itm_siz - size in bytes of each item (or tag number)
  * At exit:
+ *	data held until finish_tmp_file() is called
  */
 {
-	struct tmp_struct *ts;
-	char *tmps;
-	int code;
+	TmpStage_t *ts;
+	int32_t itz, need;
 
-	if ( tmp_fp != 0 )
+	if ( !output_files[OUT_FN_ABS].fn_present )
+		return; /* nuthin' to do if no ABS wanted */
+	itz = 0;
+	if ( itm_ptr != (char *)0 )
+		itz = (typ == TMP_TAG) ? 1 : itm_cnt * itm_siz;
+	need = stage_used + sizeof(TmpStage_t) + ((itz + 7) & ~7);
+	if ( need > stage_size )
 	{
-		int t;
-		t = fread((char *)&tmp_length, sizeof(tmp_length), 1, tmp_fp);
-		if ( t != 1 )
-		{
-			sprintf(emsg, "Error fread'ing \"%s\". Wanted %d, got %d: %s",
-					output_files[OUT_FN_TMP].fn_buff, (int)sizeof(tmp_length),
-					(int)(t * sizeof(tmp_length)), err2str(errno));
-			err_msg(MSG_FATAL, emsg);
-			EXIT_FALSE;
-		}
-		t = fread((char *)tmp_top, (int)tmp_length, 1, tmp_fp);
-		if ( t != 1 )
-		{
-			sprintf(emsg, "Error fread'ing \"%s\". Wanted %d, got %d: %s",
-					output_files[OUT_FN_TMP].fn_buff, tmp_length,
-					t * tmp_length, err2str(errno));
-			err_msg(MSG_FATAL, emsg);
-			EXIT_FALSE;
-		}
-		tmps = (char *)unsqz_it((char *)tmp_top); /* unpack the text */
-		tmps += ALIGN(tmps);
-		tmp_next = (TmpStruct_t *)tmps;
-		return (rtmp.tf_type);
+		int32_t nsiz;
+		nsiz = stage_size ? stage_size * 2 : MAX_TOKEN * 8;
+		while ( nsiz < need )
+			nsiz *= 2;
+		tmp_pool_used += nsiz - stage_size;
+		stage_buf = stage_buf ? (char *)MEM_realloc(stage_buf, nsiz) : (char *)MEM_alloc(nsiz);
+		stage_size = nsiz;
 	}
-	else
+	ts = (TmpStage_t *)(stage_buf + stage_used);
+	ts->ts_type = typ;
+	ts->ts_siz = itm_siz;
+	ts->ts_cnt = itm_cnt;
+	ts->ts_bytes = (itz + 7) & ~7;
+	if ( itz )
+		memcpy((char *)(ts + 1), itm_ptr, itz);
+	else if ( typ != TMP_TAG )
+		ts->ts_bytes = -1;     /* remember there was no item pointer */
+	stage_used = need;
+}
+
+/********************************************************************
+ * Data items whose value is known once the file's expressions are
+ * folded don't need pass2 to evaluate anything. Their bytes are laid
+ * out here and collected into TMP_BSTNG records instead. For .vlda
+ * output each item, and each repetition of a repeated item, keeps a
+ * record of its own, since .vlda text records are broken between the
+ * chunks pass2 hands to outbstr().
+ */
+static uint8_t *lit_buf;
+static int lit_used;
+#define LIT_MAX (4096)
+
+static int tag_bytes(int tag, int32_t value, uint8_t *ubp, int report);
+
+static void lit_flush(void)
+{
+	if ( lit_used )
+	{
+		put_tmp(TMP_BSTNG, lit_used, (char *)lit_buf, 1);
+		lit_used = 0;
+	}
+}
+
+static int lit_item(TmpStage_t *ts, TmpStage_t *tag)
+/*
+ * At entry:
+ *	ts - folded TMP_EXPR record
+ *	tag - the record after it
+ * At exit:
+ *	returns 1 if the item's bytes were added to lit_buf, 0 if it
+ *	has to go through pass2 as is.
+ */
+{
+	EXPR_token *exp;
+	uint8_t bytes[4];
+	int32_t lc;
+	int ii, nb;
+
+	exp = (EXPR_token *)(ts + 1);
+	if ( ts->ts_cnt != 1 || exp->expr_code != EXPR_VALUE
+		 || (char *)tag >= stage_buf + stage_used || tag->ts_type != TMP_TAG )
+		return 0;
+	if ( (lc = tag->ts_cnt) == 0 )
+		lc = 1;
+	nb = tag_bytes(*(char *)(tag + 1), exp->expr_value, bytes, 0);
+	if ( nb == 0 || nb * lc > LIT_MAX )
+		return 0;
+	if ( lit_used + nb * lc > LIT_MAX )
+		lit_flush();
+	if ( !lit_buf )
+	{
+		lit_buf = (uint8_t *)MEM_alloc(LIT_MAX);
+		misc_pool_used += LIT_MAX;
+	}
+	for (ii = 0; ii < lc; ++ii)
 	{
-		ts = tmp_next;  /* point to next tmp element */
-		if ( ts->tf_type == TMP_LINK )
+		memcpy(lit_buf + lit_used, bytes, nb);
+		lit_used += nb;
+		if ( output_mode == OUTPUT_VLDA )
+			lit_flush();    /* pass2 writes each repetition on its own */
+	}
+	return 1;
+}
+
+/********************************************************************
+ * Finish the tmp records for a file
+ */
+void finish_tmp_file(void)
+/*
+ * At entry:
+ *	called at the end of each input file, before the ID table is
+ *	let go of.
+ * At exit:
+ *	the file's records have been bound, folded and written to the
+ *	tmp stream.
+ */
+{
+	TmpStage_t *ts;
+	char *data, *end;
+	int lits;
+
+	lits = !qual_tbl[QUAL_REL].present;
+	end = stage_buf + stage_used;
+	for (ts = (TmpStage_t *)stage_buf; (char *)ts < end; ts = (TmpStage_t *)(data + ts->ts_bytes))
+	{
+		data = (char *)(ts + 1);
+		switch (ts->ts_type)
 		{
-			int ferr;
-#if defined(DEBUG_LINK)
-			printf("Reading  TMP_LINK at %p, align=%" FMT_PTRDIF_PRFX "d. New link at %p, align=%d\n",
-				   (void *)ts, ts & 3, (void *)ts->tfLink, ts->tfLink & 3);
-#endif
-			ts = tmp_next = (TmpStruct_t *)ts->tfLink;
-			if ( (ferr = MEM_free(tmp_top)) )
-			{ /* give back the memory */
-				sprintf(emsg, "Error (%08X) free'ing %d bytes at %p from tmp_pool",
-						ferr, MAX_TOKEN * 8, (void *)tmp_top);
-				err_msg(MSG_WARN, emsg);
-			}
-			tmp_top = ts;          /* point to next top */
+		case TMP_ORG:
+		case TMP_EXPR:
+		case TMP_OOR:
+		case TMP_BOFF:
+		case TMP_TEST:
+		case TMP_START:
+			bind_ids((EXPR_token *)data, ts->ts_cnt);
+			ts->ts_cnt = fold_expr((EXPR_token *)data, ts->ts_cnt);
+			break;
 		}
-		tmp_ptr = ts;             /* point to tmp pointer */
-		if ( qual_tbl[QUAL_MISER].present )
+		if ( lits && ts->ts_type == TMP_EXPR
+			 && lit_item(ts, (TmpStage_t *)(data + ts->ts_bytes)) )
 		{
-			tmps = (char *)unsqz_it((char *)tmp_ptr); /* unpack the text */
-			tmps += ALIGN(tmps);
-#if defined(DEBUG_LINK)
-			if ( tmp_ptr & 3 )
-				printf("read_from_tmp: started at unaligned %p\n", (void *)tmp_ptr);
-			if ( tmps & 3 )
-				printf("read_from_tmp: ended unaligned at %p\n", (void *)tmps);
-#endif
-			tmp_next = (TmpStruct_t *)tmps;
-			return (rtmp.tf_type);
+			ts = (TmpStage_t *)(data + ts->ts_bytes);   /* skip the TMP_TAG too */
+			data = (char *)(ts + 1);
+			continue;
+		}
+		if ( lits && ts->ts_type == TMP_BSTNG && output_mode != OUTPUT_VLDA
+			 && ts->ts_siz == 1 && ts->ts_cnt > 0 && lit_used
+			 && lit_used + ts->ts_cnt <= LIT_MAX )
+		{
+			memcpy(lit_buf + lit_used, data, ts->ts_cnt);
+			lit_used += ts->ts_cnt;
+			continue;
+		}
+		lit_flush();
+		if ( ts->ts_bytes < 0 )
+		{
+			put_tmp(ts->ts_type, ts->ts_cnt, (char *)0, ts->ts_siz);
+			ts->ts_bytes = 0;
 		}
 		else
 		{
-			++ts;
-			tmps = (char *)ts;
-			tmp_pool = ts;
-			code = tmp_ptr->tf_type;
-			switch (code)
-			{
-			case TMP_TAG:
-				{
-					++tmp_next;
-					break;
-				}
-			case TMP_EXPR:
-			case TMP_START:
-			case TMP_OOR:
-			case TMP_BOFF:
-			case TMP_TEST:
-			case TMP_ORG:
-				{
-					tmp_expr.len = expr_stack_ptr = tmp_ptr->tfLength;
-					tmp_expr.ptr = (EXPR_token *)ts;
-					tmps += expr_stack_ptr * sizeof(EXPR_token);
-					tmp_next = (TmpStruct_t *)tmps;
-					break;
-				}
-			case TMP_BSTNG:
-			case TMP_ASTNG:
-				{
-					tmps += tmp_ptr->tfLength;
-					tmps += ALIGN(tmps);
-					tmp_next = (TmpStruct_t *)tmps;
-					break;
-				}               /* -- case */
-			case TMP_EOF:
-				{
-					break;
-				}
-			default:
-				{
-					sprintf(emsg, "Internal error: Unrecognised TMP code of %02X",
-							tmp_ptr->tf_type);
-					err_msg(MSG_ERROR, emsg);
-				}
-			}              /* -- switch */
-		}                 /* -- if miser */
-	}                    /* -- if fp */
-	return (code);
+			put_tmp(ts->ts_type, ts->ts_cnt, data, ts->ts_siz);
+		}
+	}
+	lit_flush();
+	stage_used = 0;
 }
 
-static void rewind_tmp(void)
+/**********************************************************************
+ * Read a bunch of data from tmp file
+ */
+int read_from_tmp(void)
+/*
+ * At entry:
+ * At exit:
+ */
 {
-	if ( tmp_fp )
+	struct tmp_struct *ts;
+	char *tmps;
+	int code;
+
+	ts = tmp_next;  /* point to next tmp element */
+	if ( ts->tf_type == TMP_LINK )
 	{
-#ifdef VMS
-		if ( fseek(tmp_fp, 0, 0) )
-		{   /* rewind temp file */
-			sprintf(emsg, "Unable to rewind \"%s\": %s",
-					output_files[OUT_FN_TMP].fn_buff, err2str(errno));
-			err_msg(MSG_FATAL, emsg);
-			EXIT_FALSE;
-		}
-#else
-		fclose(tmp_fp);       /* close the temp file */
-		if ( (tmp_fp = fopen(output_files[OUT_FN_TMP].fn_buff, "rb")) == 0 )
-		{
-			sprintf(emsg, "Error opening tmp file \"%s\" for output: %s",
-					output_files[OUT_FN_TMP].fn_buff, err2str(errno));
-			err_msg(MSG_FATAL, emsg);
-			EXIT_FALSE;
-		}
+#if defined(DEBUG_LINK)
+		printf("Reading  TMP_LINK at %p. Next segment is %d\n",
+			   (void *)ts, tmp_cur_seg + 1);
 #endif
+		drop_tmp_seg(tmp_cur_seg);
+		ts = tmp_next = load_tmp_seg(++tmp_cur_seg);
 	}
-	else
+	tmp_ptr = ts;             /* point to tmp pointer */
+	if ( qual_tbl[QUAL_MISER].present )
 	{
-		tmp_next = tmp_top;
+		tmps = (char *)unsqz_it((char *)tmp_ptr); /* unpack the text */
+		tmps += ALIGN(tmps);
+#if defined(DEBUG_LINK)
+		if ( tmp_ptr & 3 )
+			printf("read_from_tmp: started at unaligned %p\n", (void *)tmp_ptr);
+		if ( tmps & 3 )
+			printf("read_from_tmp: ended unaligned at %p\n", (void *)tmps);
+#endif
+		tmp_next = (TmpStruct_t *)tmps;
+		return (rtmp.tf_type);
 	}
+	else
+	{
+		++ts;
+		tmps = (char *)ts;
+		tmp_pool = ts;
+		code = tmp_ptr->tf_type;
+		switch (code)
+		{
+		case TMP_TAG:
+			{
+				++tmp_next;
+				break;
+			}
+		case TMP_EXPR:
+		case TMP_START:
+		case TMP_OOR:
+		case TMP_BOFF:
+		case TMP_TEST:
+		case TMP_ORG:
+			{
+				tmp_expr.len = expr_stack_ptr = tmp_ptr->tfLength;
+				tmp_expr.ptr = (EXPR_token *)ts;
+				tmps += expr_stack_ptr * sizeof(EXPR_token);
+				tmp_next = (TmpStruct_t *)tmps;
+				break;
+			}
+		case TMP_BSTNG:
+		case TMP_ASTNG:
+			{
+				tmps += tmp_ptr->tfLength;
+				tmps += ALIGN(tmps);
+				tmp_next = (TmpStruct_t *)tmps;
+				break;
+			}               /* -- case */
+		case TMP_EOF:
+			{
+				break;
+			}
+		default:
+			{
+				sprintf(emsg, "Internal error: Unrecognised TMP code of %02X",
+						tmp_ptr->tf_type);
+				err_msg(MSG_ERROR, emsg);
+			}
+		}              /* -- switch */
+	}                 /* -- if miser */
+	return (code);
+}
+
+static void rewind_tmp(void)
+{
+	if ( spill_fp )
+		fflush(spill_fp);
+	tmp_cur_seg = 0;
+	tmp_next = load_tmp_seg(0);
 	return;
 }
 
@@ -820,10 +1589,489 @@ static void trunc_err(int32_t lowLimit, int32_t highLimit, int32_t written)
 	return;
 }
 
+/**********************************************************************
+ * Lay out a value the way a tag says to
+ */
+static int tag_bytes(int tag, int32_t value, uint8_t *ubp, int report)
+/*
+ * At entry:
+ *	tag - tag character from the TMP_TAG record
+ *	value - value to lay out (token_value if report is set)
+ *	ubp - where to put the bytes (room for 4)
+ *	report - if set, complain about values that don't fit
+ * At exit:
+ *	returns the number of bytes laid out. If report is not set,
+ *	returns 0 instead of complaining.
+ */
+{
+	int i, flip;
+
+	i = 4;          /* assume type l (LONG, low byte first) */
+	flip = 0;       /* assume not to flip it */
+	switch (tag)
+	{
+	case 'j':
+		{       /* long, high byte of low word first */
+#if (0)
+			uint8_t b0,b1,b2,b3; /* bytes in long */
+			b0 = token_value&0xFF; /* pickup individual bytes */
+			b1 = (token_value>>8)&0xFF;
+			b2 = (token_value>>16)&0xFF;
+			b3 = (token_value>>24)&0xFF;
+			token_value = (b2<<24) | (b3<<16) | (b0<<8) | (b1);
+#else
+			ubp[0] = (value >> 8) & 0xFF;
+			ubp[1] = (value)&0xFF;
+			ubp[2] = (value >> 24) & 0xFF;
+			ubp[3] = (value >> 16) & 0xFF;
+#endif
+			i = 4;
+			break;
+		}
+	case 'J':
+		{       /* long, low byte of high word first */
+#if (0)
+			uint8_t b0,b1,b2,b3; /* bytes in long */
+			b0 = token_value&0xFF; /* pickup individual bytes */
+			b1 = (token_value>>8)&0xFF;
+			b2 = (token_value>>16)&0xFF;
+			b3 = (token_value>>24)&0xFF;
+			token_value = (b1<<24) | (b0<<16) | (b3<<8) | (b2);
+
+#else
+			ubp[0] = (value >> 16) & 0xFF;
+			ubp[1] = (value >> 24) & 0xFF;
+			ubp[2] = (value)&0xFF;
+			ubp[3] = (value >> 8) & 0xFF;
+#endif
+			i = 4;
+			break;
+		}
+	case 'L':   /* long, high byte first */
+#if (0)
+		flip=1;
+#else
+		flip = 3;
+#endif
+		/* merge with little-endian */
+	case 'l':   /* long, low byte first */
+		ubp[flip] = (value)&0xFF;
+		ubp[flip ^ 1] = (value >> 8) & 0xFF;
+		ubp[flip ^ 2] = (value >> 16) & 0xFF;
+		ubp[flip ^ 3] = (value >> 24) & 0xFF;
+		i = 4;     /* 4 bytes */
+		break;     /* take easy out */
+	case 'W':
+		flip = 1;   /* short, high byte first */
+	case 'w':
+		{
+			if ( (value > 65535) || (value < -65536) )
+			{
+				if ( !report )
+					return 0;
+				trunc_err(-65536L, 65536L, value&65535);
+			}
+			ubp[flip] = (value)&0xFF;
+			ubp[flip ^ 1] = (value >> 8) & 0xFF;
+			i = 2;
+			break;
+		}
+	case 'I':
+		flip = 1;   /* short, high byte first */
+	case 'i':
+		{       /* short, low byte first */
+			i = 2;     /* 2 bytes */
+			if ( (value > 32767) || (value < -32768) )
+			{
+				if ( !report )
+					return 0;
+				trunc_err(-32678, 32768, value&65535L);
+			}
+			ubp[flip] = (value)&0xFF;
+			ubp[flip ^ 1] = (value >> 8) & 0xFF;
+			break;
+		}
+	case 'U':
+		flip = 1;   /* short, high byte first */
+	case 'u':
+		{       /* short, low byte first */
+			i = 2;     /* 2 bytes */
+			if ( value & 0xFFFF0000 )
+			{
+				if ( !report )
+					return 0;
+				trunc_err(0,65536L,value&65535L);
+			}
+			ubp[flip] = (value)&0xFF;
+			ubp[flip ^ 1] = (value >> 8) & 0xFF;
+			break;
+		}
+	case 'b':
+		{       /* byte is the same as signed char */
+			i = 1;     /* char */
+			if ( (value > 255) || (value < -128) )
+			{
+				if ( !report )
+					return 0;
+				trunc_err(-128,256,value&255);
+			}
+			*ubp = (value)&0xFF;
+			break;
+		}
+	case 'z':
+		{
+			i = 1;     /* signed char branch offset */
+			if ( value == 0 || (value&1) )
+			{
+				const char *s1;
+				if ( !report )
+					return 0;
+				if ( !value )
+				{
+					if ( qual_tbl[QUAL_OCTAL].present )
+						s1 = "Illegal branch offset of %lo at location %lo. Replaced with -2";
+					else
+						s1 = "Illegal branch offset of %lX at location 0x%X. Replaced with -2";
+				}
+				else
+				{
+					if ( qual_tbl[QUAL_OCTAL].present )
+						s1 = "Illegal odd branch offset of %lo at location %lo. Replaced with -2";
+					else
+						s1 = "Illegal odd branch offset of 0x%lX at location 0x%X. Replaced with -2";
+				}
+				sprintf(emsg, s1, value, pass2_pc );
+				err_msg(MSG_ERROR, emsg);
+				disp_offset();       /* display error offset */
+				*ubp = -2;
+				break;
+			}
+		}
+		/* FALL THROUGH TO 's' */
+	case 's':
+		{
+			i = 1;     /* signed char */
+			if ( (value > 127) || (value < -128) )
+			{
+				if ( !report )
+					return 0;
+				trunc_err(-128,128,value&255L);
+			}
+			*ubp = (value)&0xFF;
+			break;
+		}
+	case 'c':
+		{       /* char */
+			i = 1;
+			if ( value & 0xFFFFFF00 )
+			{
+				if ( !report )
+					return 0;
+				trunc_err(0,256,value&255L);
+			}
+			*ubp = (value)&0xFF;
+			break;
+		}
+	default:
+		if ( !report )
+			return 0;
+		break;
+	}
+	return i;
+}
+
 int32_t xfer_addr = 1;
 FN_struct *xfer_fnd;
 static int noout_flag;
 
+/********************************************************************
+ * The text of each ORG-delimited run is collected here and handed to
+ * outbstr() once when the run ends instead of a few bytes at a time.
+ * This is only done for .hex output and -IMAGE, where the records do
+ * not depend on how the text is broken up. .vlda records are kept
+ * from splitting items, so there each item still goes out by itself.
+ */
+static uint8_t *frag_buf;
+static int frag_size, frag_used, frag_on;
+
+static void frag_put(uint8_t *from, int len)
+{
+	if ( !frag_on )
+	{
+		outbstr(from, len);
+		return;
+	}
+	if ( frag_used + len > frag_size )
+	{
+		int nsiz = frag_size ? frag_size : 4096;
+		while ( nsiz < frag_used + len )
+			nsiz *= 2;
+		if ( frag_buf )
+			frag_buf = (uint8_t *)MEM_realloc(frag_buf, nsiz);
+		else
+			frag_buf = (uint8_t *)MEM_alloc(nsiz);
+		misc_pool_used += nsiz - frag_size;
+		frag_size = nsiz;
+	}
+	memcpy(frag_buf + frag_used, from, len);
+	frag_used += len;
+}
+
+static void frag_flush(void)
+{
+	if ( frag_used )
+	{
+		outbstr(frag_buf, frag_used);
+		frag_used = 0;
+	}
+}
+
+/********************************************************************
+ * With more than one thread, the runs of text between TMP_ORG records
+ * are laid out a batch at a time by wrk_run(), each into a piece of
+ * run_buf, and pass2() then writes them in order. A worker only does
+ * what can't produce a diagnostic: data items fx_eval() can evaluate
+ * and whose values fit their tags, strings, and .TEST type checks
+ * that pass. At anything else it gives up and pass2() reads that run
+ * the ordinary way and reports whatever is wrong. This is only done
+ * when the text is collected by frag_put() and the whole tmp stream
+ * is in memory as written (no -MISER, -PACK or spill file).
+ */
+#define RUN_BATCH		256				/* most runs laid out at a time */
+#define RUN_BATCH_BYTES	(1024*1024)		/* most tmp stream laid out at a time */
+
+typedef struct run_job
+{
+	TmpStruct_t *rj_org;	/* the run's TMP_ORG record */
+	int rj_seg;				/* tmp segment holding it */
+	uint8_t *rj_buf;		/* where to put the run's bytes */
+	int32_t rj_size;		/* room at rj_buf */
+	int32_t rj_len;			/* bytes laid out, -1 if left for pass2() */
+	TmpStruct_t *rj_end;	/* record that ends the run */
+	int rj_end_seg;			/* tmp segment holding it */
+} RunJob_t;
+
+static RunJob_t run_jobs[RUN_BATCH];
+static int run_first, run_count;	/* ORG numbers of the jobs in run_jobs */
+static int run_org;					/* ORG number of next TMP_ORG pass2() reads */
+static int run_on;					/* runs are being laid out by workers */
+static uint8_t *run_buf;
+static int32_t run_buf_size;
+
+/********************************************************************
+ * Find the record after an in-memory tmp record
+ */
+static TmpStruct_t *tmp_skip(TmpStruct_t *ts, int *seg)
+/*
+ * At entry:
+ *	ts - any record that read_from_tmp() knows other than TMP_EOF
+ *	seg - index of tmp segment holding it
+ * At exit:
+ *	returns pointer to the next record, in the next segment if
+ *	this one is followed by a TMP_LINK (*seg is updated).
+ */
+{
+	char *tmps;
+
+	tmps = (char *)(ts + 1);
+	switch (ts->tf_type)
+	{
+	case TMP_EXPR:
+	case TMP_START:
+	case TMP_OOR:
+	case TMP_BOFF:
+	case TMP_TEST:
+	case TMP_ORG:
+		tmps += ts->tfLength * sizeof(EXPR_token);
+		break;
+	case TMP_BSTNG:
+	case TMP_ASTNG:
+		tmps += ts->tfLength;
+		tmps += ALIGN(tmps);
+		break;
+	}
+	ts = (TmpStruct_t *)tmps;
+	if ( ts->tf_type == TMP_LINK )
+		ts = (TmpStruct_t *)tmp_segs[++*seg].sg_mem;
+	return ts;
+}
+
+/********************************************************************
+ * Lay out one run of text (called from wrk_run())
+ */
+static void run_job(void *arg, int job)
+/*
+ * At entry:
+ *	arg - pointer to run_jobs
+ *	job - which one to do
+ * At exit:
+ *	rj_len is the number of bytes at rj_buf and rj_end is where
+ *	the next run starts, or rj_len is -1 if pass2() has to do it.
+ */
+{
+	RunJob_t *rj = (RunJob_t *)arg + job;
+	TmpStruct_t *ts;
+	SS_struct *seg_ref;
+	uint8_t bytes[4], *dst, *end;
+	int32_t lc, value;
+	int seg, nb;
+
+	rj->rj_len = -1;
+	dst = rj->rj_buf;
+	end = dst + rj->rj_size;
+	seg = rj->rj_seg;
+	ts = tmp_skip(rj->rj_org, &seg);
+	while ( 1 )
+	{
+		switch (ts->tf_type)
+		{
+		case TMP_ORG:
+		case TMP_EOF:
+			rj->rj_end = ts;
+			rj->rj_end_seg = seg;
+			rj->rj_len = dst - rj->rj_buf;
+			return;
+		case TMP_BSTNG:
+		case TMP_ASTNG:
+			if ( ts->tfLength > end - dst )
+				return;
+			memcpy(dst, ts + 1, ts->tfLength);
+			dst += ts->tfLength;
+			break;
+		case TMP_OOR:
+		case TMP_BOFF:
+		case TMP_TEST:
+			if ( !fx_eval((EXPR_token *)(ts + 1), ts->tfLength,
+						  compile_expr((EXPR_token *)(ts + 1), ts->tfLength), &value, &seg_ref)
+				 || value )
+				return;
+			ts = tmp_skip(ts, &seg);
+			if ( ts->tf_type != TMP_ASTNG )
+				return;
+			break;      /* the check's text isn't output */
+		case TMP_EXPR:
+			if ( !fx_eval((EXPR_token *)(ts + 1), ts->tfLength, ts->tf_tag, &value, &seg_ref) )
+				return;
+			ts = tmp_skip(ts, &seg);
+			if ( ts->tf_type != TMP_TAG )
+				continue;   /* nothing to output */
+			if ( (lc = ts->tfLength) == 0 )
+				lc = 1;
+			if ( (nb = tag_bytes(ts->tf_tag, value, bytes, 0)) == 0
+				 || lc > (end - dst) / nb )
+				return;
+			while ( lc-- > 0 )
+			{
+				memcpy(dst, bytes, nb);
+				dst += nb;
+			}
+			break;
+		default:
+			return;
+		}
+		ts = tmp_skip(ts, &seg);
+	}
+}
+
+/********************************************************************
+ * Lay out a batch of runs
+ */
+static void run_batch(int first)
+/*
+ * At entry:
+ *	first - ORG number of the first run of the batch
+ * At exit:
+ *	run_jobs filled in and done for runs run_first up to (but
+ *	not including) run_first+run_count.
+ */
+{
+	TmpOrg_t *to;
+	int32_t span, total;
+	int ii, seg, end_seg;
+	int32_t end_off;
+
+	total = 0;
+	for (ii = 0; ii < RUN_BATCH && first + ii < tmp_norgs; ++ii)
+	{
+		to = tmp_orgs + first + ii;
+		if ( first + ii + 1 < tmp_norgs )
+		{
+			end_seg = to[1].to_seg;
+			end_off = to[1].to_off;
+		}
+		else
+		{
+			end_seg = tmp_nsegs - 1;
+			end_off = tmp_segs[end_seg].sg_used;
+		}
+		span = end_off - to->to_off;    /* the run can't have more bytes than this */
+		for (seg = to->to_seg; seg < end_seg; ++seg)
+			span += tmp_segs[seg].sg_used;
+		if ( ii && total + span > RUN_BATCH_BYTES )
+			break;
+		run_jobs[ii].rj_org = (TmpStruct_t *)(tmp_segs[to->to_seg].sg_mem + to->to_off);
+		run_jobs[ii].rj_seg = to->to_seg;
+		run_jobs[ii].rj_size = span;
+		total += span;
+	}
+	if ( total > run_buf_size )
+	{
+		if ( run_buf )
+			MEM_free(run_buf);
+		run_buf = (uint8_t *)MEM_alloc(total);
+		misc_pool_used += total - run_buf_size;
+		run_buf_size = total;
+	}
+	for (total = 0, seg = 0; seg < ii; ++seg)
+	{
+		run_jobs[seg].rj_buf = run_buf + total;
+		total += run_jobs[seg].rj_size;
+	}
+	run_first = first;
+	run_count = ii;
+	wrk_run(run_count, run_job, run_jobs);
+}
+
+/********************************************************************
+ * Use the workers' layout of the run after a TMP_ORG if there is one
+ */
+static void run_take(void)
+/*
+ * At entry:
+ *	tmp_ptr - points to the TMP_ORG record, which has been done
+ * At exit:
+ *	if the run was laid out, its bytes have been output and the
+ *	next read_from_tmp() gets the record after it. Otherwise
+ *	nothing has changed.
+ */
+{
+	RunJob_t *rj;
+	TmpOrg_t *to;
+	int org;
+
+	org = run_org++;
+	to = tmp_orgs + org;
+	if ( org >= tmp_norgs || to->to_seg != tmp_cur_seg
+		 || (char *)tmp_ptr != tmp_segs[tmp_cur_seg].sg_mem + to->to_off )
+	{
+		run_on = 0;     /* lost track, read the rest the ordinary way */
+		return;
+	}
+	if ( noout_flag )
+		return;
+	if ( org >= run_first + run_count )
+		run_batch(org);
+	rj = run_jobs + org - run_first;
+	if ( rj->rj_len < 0 )
+		return;
+	if ( rj->rj_len )
+		outbstr(rj->rj_buf, rj->rj_len);
+	pass2_pc += rj->rj_len;
+	while ( tmp_cur_seg < rj->rj_end_seg )
+		drop_tmp_seg(tmp_cur_seg++);
+	tmp_next = rj->rj_end;
+}
+
 /**********************************************************************
  * Pass2 - generate output
  */
@@ -835,7 +2083,7 @@ int pass2(void)
  *	output file written.
  */
 {
-	int i, r_flg = 1, flip;
+	int i, r_flg = 1;
 	int32_t lc;
 #if (0)
 	char *src,*dst,c;
@@ -845,6 +2093,20 @@ int pass2(void)
 	if ( (outxabs_fp = abs_fp) == 0 )
 		return (1); /* no output required */
 	write_to_tmp(TMP_EOF, 0, (char *)0, 0); /* make sure that there's an EOF in tmp */
+	finish_tmp_file();
+	if ( stage_buf )
+	{
+		MEM_free(stage_buf);
+		stage_buf = 0;
+		stage_size = 0;
+	}
+	if ( qual_tbl[QUAL_IMAGE].present && !qual_tbl[QUAL_REL].present )
+		outx_image();    /* build the image first, write it at termobj() */
+	frag_on = !qual_tbl[QUAL_REL].present
+		&& (output_mode == OUTPUT_HEX || qual_tbl[QUAL_IMAGE].present);
+	run_on = frag_on && tmp_norgs && wrk_count() > 1 && spill_fp == 0
+		&& !qual_tbl[QUAL_MISER].present && !qual_tbl[QUAL_PACK].present;
+	run_first = run_count = run_org = 0;
 	rewind_tmp();        /* rewind to beginning */
 	while ( 1 )
 	{
@@ -855,17 +2117,40 @@ int pass2(void)
 		{ /* see what we gotta do */
 		case TMP_EOF:
 			{
+				frag_flush();
 				termobj(xfer_addr);     /* terminate and flush the output buffer */
-				if ( !tmp_fp )
+				if ( frag_buf )
 				{
-					int ferr;
-					if ( (ferr = MEM_free(tmp_top)) )
-					{ /* give back the memory */
-						sprintf(emsg, "Error (%08X) free'ing %d bytes at %p from tmp_pool",
-								ferr, MAX_TOKEN * 8, (void *)tmp_top);
-						err_msg(MSG_WARN, emsg);
-					}
-					tmp_top = 0;
+					MEM_free(frag_buf);
+					frag_buf = 0;
+					frag_size = 0;
+				}
+				if ( run_buf )
+				{
+					MEM_free(run_buf);
+					run_buf = 0;
+					run_buf_size = 0;
+				}
+				if ( tmp_orgs )
+				{
+					MEM_free(tmp_orgs);
+					tmp_orgs = 0;
+					tmp_norgs = tmp_orgs_size = 0;
+				}
+				drop_tmp_seg(tmp_cur_seg);
+				MEM_free(tmp_segs);
+				tmp_segs = 0;
+				tmp_nsegs = tmp_segs_size = 0;
+				if ( tmp_zbuf )
+					MEM_free(tmp_zbuf);
+				if ( tmp_unpack )
+					MEM_free(tmp_unpack);
+				tmp_zbuf = tmp_unpack = 0;
+				tmp_zbuf_size = tmp_unpack_size = 0;
+				if ( spill_fp )
+				{
+					fclose(spill_fp);  /* tmpfile() deletes it */
+					spill_fp = 0;
 				}
 				return (1);     /* done with pass2 */
 			}
@@ -952,7 +2237,8 @@ int pass2(void)
 /*				dump_expr("read_from_tmp", &tmp_expr); */
 				if ( noout_flag == 0 )
 				{
-					if ( !evaluate_expression(&tmp_expr) )
+					if ( !fast_expr(&tmp_expr, tmp_ptr->tf_tag)
+						 && !evaluate_expression(&tmp_expr) )
 					{
 						disp_offset();
 					}
@@ -967,7 +2253,6 @@ int pass2(void)
 					uint8_t mea_buf[4];   /* for endian-agnostic output */
 					if ( (lc = tmp_ptr->tfLength) == 0 )
 						lc = 1; /* get the count */
-					flip = 0;        /* assume not to flip it */
 					if ( qual_tbl[QUAL_REL].present )
 					{
 						if ( tmp_expr.len != 1 || lc != 1
@@ -990,145 +2275,7 @@ int pass2(void)
 						token_value = tmp_expr.ptr->expr_value;
 					}
 					ubp = mea_buf;
-					switch (tmp_ptr->tf_tag)
-					{
-					case 'j':
-						{       /* long, high byte of low word first */
-#if (0)
-							uint8_t b0,b1,b2,b3; /* bytes in long */
-							b0 = token_value&0xFF; /* pickup individual bytes */
-							b1 = (token_value>>8)&0xFF;
-							b2 = (token_value>>16)&0xFF;
-							b3 = (token_value>>24)&0xFF;
-							token_value = (b2<<24) | (b3<<16) | (b0<<8) | (b1);
-#else
-							ubp[0] = (token_value >> 8) & 0xFF;
-							ubp[1] = (token_value)&0xFF;
-							ubp[2] = (token_value >> 24) & 0xFF;
-							ubp[3] = (token_value >> 16) & 0xFF;
-#endif
-							i = 4;
-							break;
-						}
-					case 'J':
-						{       /* long, low byte of high word first */
-#if (0)
-							uint8_t b0,b1,b2,b3; /* bytes in long */
-							b0 = token_value&0xFF; /* pickup individual bytes */
-							b1 = (token_value>>8)&0xFF;
-							b2 = (token_value>>16)&0xFF;
-							b3 = (token_value>>24)&0xFF;
-							token_value = (b1<<24) | (b0<<16) | (b3<<8) | (b2);
-
-#else
-							ubp[0] = (token_value >> 16) & 0xFF;
-							ubp[1] = (token_value >> 24) & 0xFF;
-							ubp[2] = (token_value)&0xFF;
-							ubp[3] = (token_value >> 8) & 0xFF;
-#endif
-							i = 4;
-							break;
-						}
-					case 'L':   /* long, high byte first */
-#if (0)
-						flip=1;
-#else
-						flip = 3;
-#endif
-						/* merge with little-endian */
-					case 'l':   /* long, low byte first */
-						ubp[flip] = (token_value)&0xFF;
-						ubp[flip ^ 1] = (token_value >> 8) & 0xFF;
-						ubp[flip ^ 2] = (token_value >> 16) & 0xFF;
-						ubp[flip ^ 3] = (token_value >> 24) & 0xFF;
-						i = 4;     /* 4 bytes */
-						break;     /* take easy out */
-					case 'W':
-						flip = 1;   /* short, high byte first */
-					case 'w':
-						{
-							if ( (token_value > 65535) || (token_value < -65536) )
-								trunc_err(-65536L, 65536L, token_value&65535);
-							ubp[flip] = (token_value)&0xFF;
-							ubp[flip ^ 1] = (token_value >> 8) & 0xFF;
-							i = 2;
-							break;
-						}
-					case 'I':
-						flip = 1;   /* short, high byte first */
-					case 'i':
-						{       /* short, low byte first */
-							i = 2;     /* 2 bytes */
-							if ( (token_value > 32767) || (token_value < -32768) )
-								trunc_err(-32678, 32768, token_value&65535L);
-							ubp[flip] = (token_value)&0xFF;
-							ubp[flip ^ 1] = (token_value >> 8) & 0xFF;
-							break;
-						}
-					case 'U':
-						flip = 1;   /* short, high byte first */
-					case 'u':
-						{       /* short, low byte first */
-							i = 2;     /* 2 bytes */
-							if ( token_value & 0xFFFF0000 )
-								trunc_err(0,65536L,token_value&65535L);
-							ubp[flip] = (token_value)&0xFF;
-							ubp[flip ^ 1] = (token_value >> 8) & 0xFF;
-							break;
-						}
-					case 'b':
-						{       /* byte is the same as signed char */
-							i = 1;     /* char */
-							if ( (token_value > 255) || (token_value < -128) )
-								trunc_err(-128,256,token_value&255);
-							*ubp = (token_value)&0xFF;
-							break;
-						}
-					case 'z':
-						{
-							i = 1;     /* signed char branch offset */
-							if ( token_value == 0 || (token_value&1) )
-							{
-								const char *s1;
-								if ( !token_value )
-								{
-									if ( qual_tbl[QUAL_OCTAL].present )
-										s1 = "Illegal branch offset of %lo at location %lo. Replaced with -2";
-									else
-										s1 = "Illegal branch offset of %lX at location 0x%X. Replaced with -2";
-								}
-								else
-								{
-									if ( qual_tbl[QUAL_OCTAL].present )
-										s1 = "Illegal odd branch offset of %lo at location %lo. Replaced with -2";
-									else
-										s1 = "Illegal odd branch offset of 0x%lX at location 0x%X. Replaced with -2";
-								}
-								sprintf(emsg, s1, token_value, pass2_pc );
-								err_msg(MSG_ERROR, emsg);
-								disp_offset();       /* display error offset */
-								*ubp = -2;
-								break;
-							}
-						}
-						/* FALL THROUGH TO 's' */
-					case 's':
-						{
-							i = 1;     /* signed char */
-							if ( (token_value > 127) || (token_value < -128) )
-								trunc_err(-128,128,token_value&255L);
-							*ubp = (token_value)&0xFF;
-							break;
-						}
-					case 'c':
-						{       /* char */
-							i = 1;
-							if ( token_value & 0xFFFFFF00 )
-								trunc_err(0,256,token_value&255L);
-							*ubp = (token_value)&0xFF;
-							break;
-						}
-					}
+					i = tag_bytes(tmp_ptr->tf_tag, token_value, ubp, 1);
 					/* Code as written cannot work on Big-endian machine,
 					 * so hard-code the option which was always used.
 					 * Otherwise, the duplicate open-brace messes up
@@ -1153,7 +2300,7 @@ int pass2(void)
 #if (0)
 						outbstr((uint8_t *)&token_value,i); /* write the text */
 #else
-						outbstr(ubp, i); /* write the text */
+						frag_put(ubp, i); /* write the text */
 #endif
 					}
 				}
@@ -1171,13 +2318,14 @@ int pass2(void)
 		case TMP_ASTNG:
 			{
 				if ( noout_flag == 0 )
-					outbstr((uint8_t *)tmp_pool, (int)tmp_ptr->tfLength);
+					frag_put((uint8_t *)tmp_pool, (int)tmp_ptr->tfLength);
 				pass2_pc += tmp_ptr->tfLength;
 				break;
 			}
 		case TMP_ORG:
 			{
 				struct seg_spec_struct *seg_ptr;
+				frag_flush();       /* finish the previous run */
 				last_seg_ref = 0;   /* assume no segment references */
 				noout_flag = 0;
 				if ( !evaluate_expression(&tmp_expr) )
@@ -1208,6 +2356,8 @@ int pass2(void)
 				{
 					outorg(pass2_pc = token_value, &tmp_expr);
 				}
+				if ( run_on )
+					run_take();     /* the run after it may be done already */
 				break;
 			}          /* -- case */
 		case TMP_START:
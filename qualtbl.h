@@ -0,0 +1,121 @@
+/*
+    qualtbl.h - Part of llf, a cross linker. Part of the macxx tool chain.
+    Copyright (C) 2025 David Shepperd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**************************************************************************
+ * @note This file is produced by a separate program called mk_qualtbl. *
+ * Any manual edits made to this file will likely be lost during the next *
+ * build. Edit mk_qualtbl.c and/or qualtbl.dat to make any necessary  *
+ * changes to these lists.                                                *
+ **************************************************************************/
+
+
+
+/* numLines=28, __SIZEOF_SIZE_T__=8, __SIZEOF_INT__=4, __SIZEOF_LONG__=8 */
+/* sizeof(char)=1, sizeof(int)=4, sizeof(long)=8, sizeof(void *)=8 */
+/* sizeof(int8_t)=1, sizeof(int16_t)=2, sizeof(int32_t)=4 */
+/* sizeof(sizeof)=8, sizeof(size_t)=8, sizeof(time_t)=8 */
+
+#if QUALTBL_GET_ENUM
+typedef enum
+{
+    QUAL_OPT,	/* Option input file */
+    QUAL_LIB,	/* Library input file */
+    QUAL_CROSS,	/* Cross reference request */
+    QUAL_REL,	/* Relative output */
+    QUAL_ERR,	/* Force display of undefined symbols */
+    QUAL_VLDA,	/* Create .vlda output (same as -binary) */
+    QUAL_OBJ,	/* Default input is .ob vs. normal .ol */
+    QUAL_OCTAL,	/* Print octal numbers in map file */
+    QUAL_DEB,	/* Debug flags */
+    QUAL_FN_TMP,	/* Specify temp filename */
+    QUAL_FN_ABS,	/* Specify the output filename */
+    QUAL_FN_SYM,	/* Specify the symbol filename */
+    QUAL_FN_MAP,	/* Specify the map filename */
+    QUAL_FN_SEC,	/* Specify the section filename */
+    QUAL_FN_STB,	/* Specify the stb filename */
+    QUAL_BINARY,	/* Create .vlda output (same as -vlda) */
+    QUAL_MISER,	/* Operate in miser mode */
+    QUAL_QUIET,	/* Don't complain about multiple defines via .stb input */
+    QUAL_MMAP,	/* Read text input through a memory mapped file */
+    QUAL_INDEX,	/* Build/use compiled library indexes */
+    QUAL_MEMLIMIT,	/* Memory budget in Kbytes before spilling to disk */
+    QUAL_PACK,	/* Compress finished tmp segments */
+    QUAL_IMAGE,	/* Build the whole image before writing it */
+    QUAL_BUFSIZE,	/* Output file buffer size in Kbytes */
+    QUAL_ASYNC,	/* Write map/sym/sec/stb files from threads */
+    QUAL_FN_JSON,	/* Specify the JSON Lines map filename */
+    QUAL_THREADS,	/* Number of worker threads */
+    QUAL_MAX	/* This must be last */
+} QualifierIDs_t;
+
+typedef struct qual
+{
+    unsigned int noval:1;	/* value is not allowed */
+    unsigned int optional:1;	/* value is optional */
+    unsigned int number:1;	/* value must be a number */
+    unsigned int negate:1;	/* value is negatable */
+    unsigned int output:1;	/* parameter is an output file */
+    unsigned int error:1;	/* field is in error */
+    unsigned int negated:1;	/* option is negated */
+    unsigned int present:1;	/* up to next byte boundary */
+    unsigned char outIdx;	/* output file index */
+    const char *string;		/* pointer to qualifier ascii string */
+    int id;					/* enum value */
+    int32_t valueInt;		/* parameter value if number */
+    char *valuePtr;			/* parameter value if string */
+} QualTable_t;
+
+extern QualTable_t qual_tbl[QUAL_MAX];
+
+#undef QUALTBL_GET_ENUM
+#endif /* QUALTBL_GET_ENUM */
+
+#if QUALTBL_GET_OTHERS
+
+QualTable_t qual_tbl[QUAL_MAX] = 
+{
+    { 0,0,0,0,1,0,0,0,0,"OPTIONS",QUAL_OPT,0,NULL },	/* Option input file */
+    { 0,0,0,0,1,0,0,0,0,"LIBRARY",QUAL_LIB,0,NULL },	/* Library input file */
+    { 1,0,0,1,1,0,0,0,0,"CROSS_REFERENCE",QUAL_CROSS,0,NULL },	/* Cross reference request */
+    { 1,0,0,1,1,0,0,0,0,"RELATIVE",QUAL_REL,0,NULL },	/* Relative output */
+    { 1,0,0,1,1,0,0,0,0,"ERROR",QUAL_ERR,0,NULL },	/* Force display of undefined symbols */
+    { 1,0,0,1,1,0,0,0,0,"VLDA",QUAL_VLDA,0,NULL },	/* Create .vlda output (same as -binary) */
+    { 1,0,0,1,1,0,0,0,0,"OBJECT",QUAL_OBJ,0,NULL },	/* Default input is .ob vs. normal .ol */
+    { 1,0,0,1,1,0,0,0,0,"OCTAL",QUAL_OCTAL,0,NULL },	/* Print octal numbers in map file */
+    { 0,1,1,1,1,0,0,0,0,"DEBUG",QUAL_DEB,0,NULL },	/* Debug flags */
+    { 0,1,0,1,1,0,0,0,OUT_FN_TMP,"TEMPFILE",QUAL_FN_TMP,0,NULL },	/* Specify temp filename */
+    { 0,1,0,1,1,0,0,0,OUT_FN_ABS,"OUTPUT",QUAL_FN_ABS,0,NULL },	/* Specify the output filename */
+    { 0,1,0,1,1,0,0,0,OUT_FN_SYM,"SYMBOL",QUAL_FN_SYM,0,NULL },	/* Specify the symbol filename */
+    { 0,1,0,1,1,0,0,0,OUT_FN_MAP,"MAP",QUAL_FN_MAP,0,NULL },	/* Specify the map filename */
+    { 0,1,0,1,1,0,0,0,OUT_FN_SEC,"SECTION",QUAL_FN_SEC,0,NULL },	/* Specify the section filename */
+    { 0,1,0,1,1,0,0,0,OUT_FN_STB,"STB",QUAL_FN_STB,0,NULL },	/* Specify the stb filename */
+    { 1,0,0,1,1,0,0,0,0,"BINARY",QUAL_BINARY,0,NULL },	/* Create .vlda output (same as -vlda) */
+    { 1,0,0,1,1,0,0,0,0,"MISER",QUAL_MISER,0,NULL },	/* Operate in miser mode */
+    { 1,0,0,1,1,0,0,0,0,"QUIET",QUAL_QUIET,0,NULL },	/* Don't complain about multiple defines via .stb input */
+    { 1,0,0,1,1,0,0,0,0,"MMAP",QUAL_MMAP,0,NULL },	/* Read text input through a memory mapped file */
+    { 1,0,0,1,1,0,0,0,0,"INDEX",QUAL_INDEX,0,NULL },	/* Build/use compiled library indexes */
+    { 0,0,1,0,1,0,0,0,0,"MEMLIMIT",QUAL_MEMLIMIT,0,NULL },	/* Memory budget in Kbytes before spilling to disk */
+    { 1,0,0,1,1,0,0,0,0,"PACK",QUAL_PACK,0,NULL },	/* Compress finished tmp segments */
+    { 1,0,0,1,1,0,0,0,0,"IMAGE",QUAL_IMAGE,0,NULL },	/* Build the whole image before writing it */
+    { 0,0,1,0,1,0,0,0,0,"BUFSIZE",QUAL_BUFSIZE,0,NULL },	/* Output file buffer size in Kbytes */
+    { 1,0,0,1,1,0,0,0,0,"ASYNC",QUAL_ASYNC,0,NULL },	/* Write map/sym/sec/stb files from threads */
+    { 0,1,0,1,1,0,0,0,OUT_FN_JSON,"JSON",QUAL_FN_JSON,0,NULL },	/* Specify the JSON Lines map filename */
+    { 0,0,1,0,1,0,0,0,0,"THREADS",QUAL_THREADS,0,NULL }	/* Number of worker threads */
+};
+#undef QUALTBL_GET_OTHERS
+#endif /* QUALTBL_GET_OTHERS */
@@ -132,44 +132,6 @@ int chk)            /* if true, check for overlap */
 }
 
 
-/* exchange segments in the segment list */
-static void swap_segs(SS_struct **one, SS_struct **two)
-{
-    struct ss_struct *a,*b,*tmp,**tmpp;
-    a = *one;
-    b = *two;
-    if (a->ss_next == b)
-    {       /* adjacent entries are special */
-        a->ss_next = b->ss_next;
-        b->ss_next = a;
-        tmpp = a->ss_prev;
-        a->ss_prev = &b->ss_next;
-        b->ss_prev = tmpp;
-        *tmpp = b;
-        if (a->ss_next) a->ss_next->ss_prev = &a->ss_next;
-        a->flg_more = b->flg_more;
-        b->flg_more = 1;
-    }
-    else
-    {
-        if (b->ss_next != 0) b->ss_next->ss_prev = &a->ss_next;
-        a->ss_next->ss_prev = &b->ss_next;
-        tmpp = a->ss_prev;
-        a->ss_prev = b->ss_prev;
-        *b->ss_prev = a;
-        *tmpp = b;
-        b->ss_prev = tmpp;
-        tmp = a->ss_next;
-        a->ss_next = b->ss_next;
-        b->ss_next = tmp;
-        a->flg_more = b->flg_more;
-        b->flg_more = 1;
-    }
-    *two = a;
-    *one = b;
-    return;
-}
-
 void dump_segtree( SS_struct *a )
 {
     fprintf(stderr,"Dumping tree...\n");
@@ -189,66 +151,124 @@ void dump_segtree( SS_struct *a )
     return;
 }
 
+static SS_struct **sort_list;	/* scratch for sort_segs() */
+static int sort_list_size;	/* number of entries in sort_list */
+
 /***********************************************************************
- * Sort by size. This procedure will sort a list of segments in place and
- * in order by size, descending.
+ * Sort a run of like named segments. The segments are gathered into an
+ * array, merge sorted (so segments that compare equal keep their order)
+ * and the chain is relinked once.
  */
-static struct ss_struct *sort_by_size( 
+static struct ss_struct *sort_segs(
 /*
  * At entry:
  */
-struct ss_struct *first)   /* ptr to first struct in the chain */
+struct ss_struct *first,   /* ptr to first struct in the chain */
+int (*before)(SS_struct *, SS_struct *)) /* TRUE if arg 1 goes ahead of arg 2 */
 /*
  * At exit:
- *	nothing. Elements in the list will be
- *	sorted descending according to segment size.
+ *	returns pointer to the new first struct in the chain
  */
 {
-    struct ss_struct *a,*b,**beg;
+    struct ss_struct *ms,*tail,**beg,**v,**tmp,**src,**dst,**swp;
+    int n,ii,jj,kk,lo,mid,hi,width;
+
     beg = first->ss_prev;
-    for (a=first;a && a->flg_more;a=a->ss_next)
+    for (n=1,ms=first; ms->flg_more; ms=ms->ss_next) ++n;
+    if (n < 2) return first;
+    tail = ms->ss_next;      /* whatever follows the run stays put */
+    if (2*n > sort_list_size)
     {
-        for (b=a->ss_next;b;b=b->ss_next)
+        misc_pool_used += (2*n-sort_list_size)*sizeof(SS_struct *);
+        sort_list_size = 2*n;
+        if (sort_list)
+            sort_list = (SS_struct **)MEM_realloc((char *)sort_list,sort_list_size*sizeof(SS_struct *));
+        else
+            sort_list = (SS_struct **)MEM_alloc(sort_list_size*sizeof(SS_struct *));
+    }
+    v = sort_list;
+    tmp = sort_list+n;
+    for (ii=0,ms=first; ii < n; ++ii,ms=ms->ss_next) v[ii] = ms;
+    src = v;
+    dst = tmp;
+    for (width=1; width < n; width *= 2)
+    {   /* bottom up merge sort */
+        for (lo=0; lo < n; lo = hi)
         {
-            if (a->seg_spec->seg_len < b->seg_spec->seg_len)
-            {
-                swap_segs(&a,&b);
+            mid = lo+width < n ? lo+width : n;
+            hi = mid+width < n ? mid+width : n;
+            ii = jj = lo;
+            kk = mid;
+            while (ii < mid || kk < hi)
+            {   /* take from the right only if it strictly goes first */
+                if (kk >= hi || (ii < mid && !before(src[kk],src[ii])))
+                    dst[jj++] = src[ii++];
+                else
+                    dst[jj++] = src[kk++];
             }
-            if (!b->flg_more) break;
-        } 
+        }
+        swp = src;
+        src = dst;
+        dst = swp;
+    }
+    *beg = src[0];
+    src[0]->ss_prev = beg;
+    for (ii=0; ii < n-1; ++ii)
+    {
+        src[ii]->ss_next = src[ii+1];
+        src[ii]->flg_more = 1;
+        src[ii+1]->ss_prev = &src[ii]->ss_next;
     }
+    src[n-1]->ss_next = tail;
+    src[n-1]->flg_more = 0;
+    if (tail) tail->ss_prev = &src[n-1]->ss_next;
     return *beg;
 }
 
+static int bigger_seg(SS_struct *a, SS_struct *b)
+{
+    return a->seg_spec->seg_len > b->seg_spec->seg_len;
+}
+
+static int lower_seg(SS_struct *a, SS_struct *b)
+{
+    return a->seg_spec->seg_base < b->seg_spec->seg_base;
+}
+
+/***********************************************************************
+ * Sort by size. This procedure will sort a list of segments in place and
+ * in order by size, descending.
+ */
+struct ss_struct *sort_by_size( 
+/*
+ * At entry:
+ */
+struct ss_struct *first)   /* ptr to first struct in the chain */
+/*
+ * At exit:
+ *	Elements in the list will be sorted descending according to
+ *	segment size. Returns ptr to the new first struct in the chain.
+ */
+{
+    return sort_segs(first,bigger_seg);
+}
+
 /***********************************************************************
  * Sort by base. This procedure will sort a list of segments in place and
  * in order by base address, ascending.
  */
-static struct ss_struct *sort_by_base(
+struct ss_struct *sort_by_base(
 /*
  * At entry:
  */
 struct ss_struct *first)   /* ptr to first struct in the chain */
 /*
  * At exit:
- *	nothing. Elements in the list will be
- *	sorted ascending according to base address.
+ *	Elements in the list will be sorted ascending according to
+ *	base address. Returns ptr to the new first struct in the chain.
  */
 {
-    struct ss_struct *a,*b,**beg;
-    beg = first->ss_prev;
-    for (a=first;a && a->flg_more;a=a->ss_next)
-    {
-        for (b=a->ss_next;b;b=b->ss_next)
-        {
-            if (a->seg_spec->seg_base > b->seg_spec->seg_base)
-            {
-                swap_segs(&a,&b);
-            }
-            if (!b->flg_more) break;
-        } 
-    }
-    return *beg;
+    return sort_segs(first,lower_seg);
 }
 
 /***********************************************************************
@@ -266,6 +286,7 @@ void seg_locate( void )
     struct seg_spec_struct *seg_ptr,*grpseg_ptr;
     uint32_t base, align=0, seg_len=0, next_base, bottom, top, offset;
     int  f_based, jj, f_fit, f_stable;
+    char *s;
     RM_control *rm_save=0;
 
     for (jj=0; jj < 4; ++jj)
@@ -374,6 +395,11 @@ void seg_locate( void )
             if (jj == 1)
             {
                 if (!f_based) continue;     /* skip if not based */
+                if (grpseg_ptr->sflg_fit)
+                {    /* FIT groups aren't placed exactly, do them with the rest */
+                    grp_nam->flg_based = 0;
+                    continue;
+                }
             }
             else if (jj == 2)
             {
@@ -405,6 +431,15 @@ void seg_locate( void )
                 rm_control = clone_rm_mem(rm_save);
             }
 
+/**************************************************************************
+ * FIT groups are packed best fit decreasing before the segments are walked
+ **************************************************************************/
+
+            if (f_fit && !f_stable && !qual_tbl[QUAL_REL].present)
+            {
+                pack_group(grp_nam, ls, bottom);
+            }
+
 /**************************************************************************
  * Now we loop through all the segments in this group and locate them
  **************************************************************************/
@@ -484,9 +519,30 @@ void seg_locate( void )
                     {
                         seg_place(ms, grp_nam, base, offset, seg_len, chk_flg);
                     }
+                    else if (f_fit && seg_ptr->sflg_packed)
+                    {
+                        base = seg_ptr->seg_base; /* pack_group() already placed it */
+                        ms->ss_value = base;
+                        seg_ptr->seg_offset = offset;
+                    }
                     else
                     {
                         base = seg_fit(ms, grp_nam, f_stable?base:bottom, offset, seg_len, align, chk_flg);
+                        if (f_fit && grpseg_ptr->seg_maxlen != 0 && seg_len != 0 && (!ovr_flg || ms == st)
+                            && base+seg_len-bottom > grpseg_ptr->seg_maxlen)
+                        {   /* pack_group() found no room for it below TO */
+                            grpseg_ptr->seg_fill_over += seg_len;
+                            ++grpseg_ptr->seg_fill_nover;
+                            if (jj != 0)
+                            {
+                                s = qual_tbl[QUAL_OCTAL].present ?
+                                    "No room for segment {%s} in FIT group {%s} up to %010lo. Placed at %010lo\n":
+                                    "No room for segment {%s} in FIT group {%s} up to %08lX. Placed at %08lX\n";
+                                sprintf(emsg, s, ms->ss_string, grp_nam->ss_string,
+                                        (unsigned long)(bottom+grpseg_ptr->seg_maxlen-1), (unsigned long)base);
+                                err_msg(MSG_ERROR,emsg);
+                            }
+                        }
                     }           
                     t = base+seg_len;
                     if (seg_len > 0 && t-1 < base)
@@ -18,53 +18,191 @@
 
 #include <stdio.h>		/* get standard I/O definitions */
 #include <ctype.h>
+#include <string.h>
 #include "token.h"		/* define compile time constants */
 #include "structs.h"		/* define structures */
 #include "header.h"
 
+/*
+ * The reserved memory areas are kept as a treap (a binary search tree
+ * keyed on rm_start that is kept balanced by a random heap priority).
+ * The areas in the tree never overlap or touch; add_to_reserve() merges
+ * them as they arrive. Each node also carries the lowest start, the
+ * highest end and the largest hole between areas found in its subtree,
+ * so check_reserve() is a single descent and get_free_space() can skip
+ * any subtree without a hole big enough to hold the request.
+ *
+ * The nodes live in one array and link to each other by index (0 is
+ * the empty link and entry 0 is never used), so clone_rm_mem() is a
+ * straight copy of the array. seg_locate() uses that to snapshot and
+ * restore the list between passes.
+ */
+
 RM_control *rm_control;     /* all reserved memory info is recorded here */
 int32_t rm_pool_used;
 
+static uint32_t rm_seed = 0x2545F491;	/* treap priority generator */
+
+#define RM_END(rm) ((rm)->rm_start+(rm)->rm_len)
+
 /**********************************************************************
- * Get a reserved_memory block of memory
+ * Get a reserved_memory node
  */
-static struct rm_struct *get_rm_mem(RM_control **rmcp)
+static int get_rm_mem(RM_control **rmcp, uint32_t start, uint32_t len)
 /*
  * At entry:
- *	no requirements
+ *	rmcp - pointer to pointer to RM_control struct
+ *	start - first address of area
+ *	len - length of area
  * At exit:
- *	rm_control will have been created and/or updated.
+ *	*rmcp will have been created and/or updated.
+ *	returns index of new node
  */
 {
     RM_control *rmc;
+    RM_struct *rm;
+    int ii;
 
     if ((rmc = *rmcp) == 0)
     {    /* if first time through */
         *rmcp = rmc = (RM_control *)MEM_alloc(sizeof(RM_control));
-        rmc->size = 16;
-        rmc->list = (RM_struct **)MEM_alloc(rmc->size*sizeof(RM_struct *));
-        rmc->used = 0;
-        rmc->free = 0;
-        rmc->pool_used = sizeof(RM_control) + rmc->size*sizeof(RM_struct *);
+        rmc->size = 32;
+        rmc->list = (RM_struct *)MEM_alloc(rmc->size*sizeof(RM_struct));
+        rmc->used = 1;		/* entry 0 is the empty link */
+        rmc->pool_used = sizeof(RM_control) + rmc->size*sizeof(RM_struct);
         rm_pool_used += rmc->pool_used;
     }
-    if (rmc->free <= 0)
+    if ((ii = rmc->free) != 0)
+    {
+        rmc->free = rmc->list[ii].rm_left;	/* pop the free list */
+    }
+    else
     {
         if (rmc->used >= rmc->size)
         {
-            rmc->size += 16;
-            rmc->list = (RM_struct **)MEM_realloc((char *)rmc->list, rmc->size*sizeof(RM_struct *));
-            rmc->pool_used += 16*sizeof(rmc);
-            rm_pool_used += 16*sizeof(rmc);
+            rmc->list = (RM_struct *)MEM_realloc((char *)rmc->list, 2*rmc->size*sizeof(RM_struct));
+            rmc->pool_used += rmc->size*sizeof(RM_struct);
+            rm_pool_used += rmc->size*sizeof(RM_struct);
+            rmc->size *= 2;
         }
-        rmc->free = 32;
-        rmc->next = rmc->list[rmc->used++] = (RM_struct *)MEM_alloc(rmc->free*sizeof(RM_struct));
-        if (rmc->top == 0) rmc->top = rmc->next;
-        rmc->pool_used += rmc->free * sizeof(RM_struct);
-        rm_pool_used += rmc->free * sizeof(RM_struct);
+        ii = rmc->used++;
     }
-    --rmc->free;
-    return rmc->next++;
+    rm_seed ^= rm_seed << 13;	/* xorshift32 */
+    rm_seed ^= rm_seed >> 17;
+    rm_seed ^= rm_seed << 5;
+    rm = rmc->list + ii;
+    rm->rm_start = rm->rm_first = start;
+    rm->rm_len = len;
+    rm->rm_last = start+len;
+    rm->rm_gap = 0;
+    rm->rm_prio = rm_seed;
+    rm->rm_left = rm->rm_right = 0;
+    ++rmc->count;
+    return ii;
+}
+
+/**********************************************************************
+ * Return a subtree of nodes to the free list
+ */
+static void put_rm_mem(RM_control *rmc, int ii)
+/*
+ * At entry:
+ *	rmc - pointer to RM_control struct
+ *	ii - index of subtree to free
+ * At exit:
+ *	all the nodes in the subtree are on the free list
+ */
+{
+    RM_struct *rm;
+    while (ii)
+    {
+        int nxt;
+        rm = rmc->list + ii;
+        put_rm_mem(rmc, rm->rm_left);
+        nxt = rm->rm_right;
+        rm->rm_left = rmc->free;
+        rmc->free = ii;
+        --rmc->count;
+        ii = nxt;
+    }
+}
+
+/**********************************************************************
+ * Recompute the subtree summary of a node from its children
+ */
+static void rm_update(RM_struct *list, int ii)
+{
+    RM_struct *rm = list + ii, *kid;
+    uint32_t gap;
+
+    rm->rm_first = rm->rm_start;
+    rm->rm_last = RM_END(rm);
+    rm->rm_gap = 0;
+    if (rm->rm_left)
+    {
+        kid = list + rm->rm_left;
+        rm->rm_first = kid->rm_first;
+        gap = rm->rm_start - kid->rm_last;
+        rm->rm_gap = kid->rm_gap > gap ? kid->rm_gap : gap;
+    }
+    if (rm->rm_right)
+    {
+        kid = list + rm->rm_right;
+        rm->rm_last = kid->rm_last;
+        gap = kid->rm_first - RM_END(rm);
+        if (gap < kid->rm_gap) gap = kid->rm_gap;
+        if (rm->rm_gap < gap) rm->rm_gap = gap;
+    }
+}
+
+/**********************************************************************
+ * Split a subtree into the nodes below an address and the rest
+ */
+static void rm_split(RM_struct *list, int ii, uint32_t key, int *lo, int *hi)
+/*
+ * At entry:
+ *	list - node array
+ *	ii - index of subtree to split
+ *	key - address to split at
+ * At exit:
+ *	*lo - subtree of nodes with rm_start < key
+ *	*hi - subtree of nodes with rm_start >= key
+ */
+{
+    if (ii == 0)
+    {
+        *lo = *hi = 0;
+        return;
+    }
+    if (list[ii].rm_start < key)
+    {
+        rm_split(list, list[ii].rm_right, key, &list[ii].rm_right, hi);
+        *lo = ii;
+    }
+    else
+    {
+        rm_split(list, list[ii].rm_left, key, lo, &list[ii].rm_left);
+        *hi = ii;
+    }
+    rm_update(list, ii);
+}
+
+/**********************************************************************
+ * Join two subtrees where every node in lo is below every node in hi
+ */
+static int rm_merge(RM_struct *list, int lo, int hi)
+{
+    if (lo == 0) return hi;
+    if (hi == 0) return lo;
+    if (list[lo].rm_prio > list[hi].rm_prio)
+    {
+        list[lo].rm_right = rm_merge(list, list[lo].rm_right, hi);
+        rm_update(list, lo);
+        return lo;
+    }
+    list[hi].rm_left = rm_merge(list, lo, list[hi].rm_left);
+    rm_update(list, hi);
+    return hi;
 }
 
 /**********************************************************************
@@ -78,14 +216,9 @@ void free_rm_mem(RM_control **rmcp)
  *	*rmcp free'd and cleared
  */
 {
-    int ii;
     RM_control *rmc;
     if ((rmc = *rmcp) == 0) return;  /* nothing to do */
-    for (ii=0; ii < rmc->used; ++ii)
-    {
-        MEM_free((char *)rmc->list[ii]);  /* free memory */
-    }
-    MEM_free((char *)rmc->list);     /* free the list */
+    MEM_free((char *)rmc->list);     /* free the nodes */
     rm_pool_used -= rmc->pool_used;
     MEM_free((char *)rmc);
     *rmcp = 0;
@@ -103,48 +236,16 @@ RM_control *clone_rm_mem(RM_control *rmc)
  *	returns pointer to new RM_control struct with duplicate data in it
  */
 {
-    RM_control *new=0;
-    RM_struct *curr=0,*next,*old;
+    RM_control *new;
     if (rmc == 0) return 0;      /* nothing to do */
-    old = rmc->top;          /* point to first element in chain */
-    do
-    {
-        next = get_rm_mem(&new);      /* get an entry */
-        if (curr) curr->rm_next = next;
-        curr = next;
-        curr->rm_start = old->rm_start;
-        curr->rm_len = old->rm_len;
-    } while ((old=old->rm_next) != 0);
-    curr->rm_next = 0;
+    new = (RM_control *)MEM_alloc(sizeof(RM_control));
+    *new = *rmc;
+    new->list = (RM_struct *)MEM_alloc(new->size*sizeof(RM_struct));
+    memcpy(new->list, rmc->list, rmc->used*sizeof(RM_struct));
+    rm_pool_used += new->pool_used;
     return new;
 }
 
-/****************************************************************************
- * Fold reserved memory list collapsing overlapping entries to a single one
- */
-static void fold_reservmem(RM_struct *rm)
-/*
- * At entry:
- *	rm - pointer to RM_struct struct which to collapse
- * At exit:
- *	returns nothing
- */
-{
-    uint32_t start,end;
-    struct rm_struct *nrm;
-    if ((nrm=rm->rm_next) == 0) return;
-    start = rm->rm_start;
-    while (nrm)
-    {
-        end = start+rm->rm_len;
-        if (nrm->rm_start > end) break;
-        if (end < nrm->rm_start+nrm->rm_len) rm->rm_len += nrm->rm_len-(end-nrm->rm_start);
-        rm->rm_next = nrm->rm_next;
-        nrm = nrm->rm_next;
-    }
-    return;
-}
-
 /**********************************************************************
  * Add an item to the reserved memory list
  */
@@ -158,89 +259,52 @@ uint32_t len;
  *	len   - length of area to exclude
  * At exit:
  *	will have updated reserved memory list. merges overlapping
- *	areas into one.
+ *	and adjacent areas into one.
  */
 {
-    uint32_t et,end;
-    int condit;
-    struct rm_struct **prev=0, *rm, *nrm;;
+    uint32_t end;
+    int lo, mid, hi, ii;
+    RM_struct *list;
+
+    end = start + len;        /* compute end address */
+    if (end < start)
+    {
+        end = 0xFFFFFFFFl;
+        len = 0xFFFFFFFFl-start;
+    }
     if (!len) return;        /* don't do anything if adding a 0 len seg */
-    if (rm_control && (rm = rm_control->top) != 0)
+    if (rm_control == 0 || rm_control->root == 0)
     {
-        prev = &rm_control->top;
-        end = start + len;        /* compute end address */
-        if (end < start)
-        {
-            end = 0xFFFFFFFFl;
-            len = 0xFFFFFFFFl-start;
-        }
-        while (1)
-        {
-            et = rm->rm_start+rm->rm_len;  /* compute end address */
-            if (et < rm->rm_start)
-            {
-                et = 0xFFFFFFFFl;
-                rm->rm_len = 0xFFFFFFFFl-rm->rm_start;
-            }
-            condit = 1*(start == rm->rm_start)+
-                     2*(start < rm->rm_start) +
-                     4*(end == et)            +
-                     8*(end < et);
-            switch (condit)
-            {
-            case 4:             /* ns >  os && ne == oe */
-            case 8:             /* ns >  os && ne <  oe */
-            case 5:             /* ns == os && ne == oe */
-            case 9: return;         /* ns == os && ne <  oe */
-            case 1: {               /* ns == os && ne >  oe */
-                    rm->rm_len = len;        /* make oe = ne */
-                    fold_reservmem(rm);      /* merge overlapping segments */
-                    return;              /* done */
-                }
-            case 2:             /* ns <  os && ne >  oe */
-            case 6: {               /* ns <  os && ne == oe */
-                    rm->rm_len = len;        /* oe = ne */
-                    rm->rm_start = start;        /* os = ns */
-                    fold_reservmem(rm);      /* merge overlapping segments */
-                    return;              /* done */
-                }
-            case 10: {              /* ns <  os && ne <  oe */
-                    if ( end >= rm->rm_start)
-                    {  /* if ns <  os && ne >= os */
-                        rm->rm_len += rm->rm_start-start; /* increase the length */
-                        rm->rm_start = start;     /* make os = ns */
-                    }
-                    else
-                    {             /* ns <  os && ne <  os */
-                        nrm = get_rm_mem(&rm_control);/* there's a hole. Get a rm_struct */
-                        nrm->rm_start = start;    /* set the start */
-                        nrm->rm_len = len;        /* set the length */
-                        nrm->rm_next = rm;        /* link the new to the old */
-                        *prev = nrm;          /* link previous to new */
-                    }
-                    return;              /* done */
-                }
-            case 0: {               /* ns >  os && ne >  oe */
-                    if (start <= et)
-                    {       /* if ns >  os && ns <= oe */
-                        rm->rm_len = end - rm->rm_start; /* oe = ne */
-                        fold_reservmem(rm);       /* merge overlapping segments */
-                        return;
-                    }
-                    break;               /* skip to next entry */
-                }
-            }
-            prev = &rm->rm_next;           /* point to previous link */
-            if ((rm = rm->rm_next) == 0) break;    /* link to next */
-        }                     /* --while */
-    }                        /* --if */
-    rm = get_rm_mem(&rm_control);        /* get some memory */
-    rm->rm_start = start;            /* insert the start */
-    rm->rm_len = len;                /* and the length */
-    if (prev)
+        ii = get_rm_mem(&rm_control, start, len);
+        rm_control->root = ii;
+        return;
+    }
+    list = rm_control->list;
+    rm_split(list, rm_control->root, start, &lo, &hi);
+    if (lo)
     {
-        *prev = rm;               /* point previous to new */
+        for (ii=lo; list[ii].rm_right; ii = list[ii].rm_right);
+        if (RM_END(list+ii) >= start)
+        {    /* the area below reaches us, so absorb it */
+            int prv;
+            start = list[ii].rm_start;
+            if (end < RM_END(list+ii)) end = RM_END(list+ii);
+            rm_split(list, lo, start, &lo, &prv);
+            put_rm_mem(rm_control, prv);
+        }
+    }
+    mid = hi;
+    hi = 0;
+    if (mid && end != 0xFFFFFFFFl)
+        rm_split(list, mid, end+1, &mid, &hi);
+    if (mid)
+    {    /* absorb everything that starts inside or right after us */
+        if (end < list[mid].rm_last) end = list[mid].rm_last;
+        put_rm_mem(rm_control, mid);
     }
+    ii = get_rm_mem(&rm_control, start, end-start);
+    list = rm_control->list;	/* may have moved */
+    rm_control->root = rm_merge(list, rm_merge(list, lo, ii), hi);
     return;          /* that's all there is to it */
 }               /* --add_to_reserve */
 
@@ -257,35 +321,71 @@ int check_reserve(uint32_t start, uint32_t len)
  *	returns TRUE if specified area is in the reserved memory list
  */
 {
-    uint32_t et,end;
-    struct rm_struct *rm;
+    uint32_t end;
+    int ii, fnd=0;
+    RM_struct *list;
     if (!len) return FALSE;  /* 0 len segment is not in list */
-    if (rm_control == 0 || (rm=rm_control->top) == 0)
+    if (rm_control == 0 || (ii=rm_control->root) == 0)
     {
         return FALSE;     /* reserved memory is emtpy */
     }
     end = start + len - 1;       /* compute end address */
-    do
-    {
-        et = rm->rm_start + rm->rm_len - 1;
-        if (start >= rm->rm_start && start <= et)
+    if (end < start) end = 0xFFFFFFFFl;
+    list = rm_control->list;
+    while (ii)
+    {    /* find the last area that starts at or before our end */
+        if (list[ii].rm_start <= end)
         {
-            return TRUE;           /* it's in the tables */
+            fnd = ii;
+            ii = list[ii].rm_right;
         }
-        if (end >= rm->rm_start && end <= et)
+        else
         {
-            return TRUE;           /* it's in the table */
+            ii = list[ii].rm_left;
         }
-        if (start < rm->rm_start && end > et)
-        {
-            return TRUE;           /* it's in the table */
+    }
+    if (fnd && RM_END(list+fnd) > start)
+        return TRUE;           /* it's in the table */
+    return FALSE; /* not in the list */
+}
+
+/**********************************************************************
+ * First fit search of a subtree
+ */
+static int rm_fit(RM_struct *list, int ii, uint32_t len, uint32_t *sta, int align)
+/*
+ * At entry:
+ *	list - node array
+ *	ii - subtree to search
+ *	len - length of area needed
+ *	sta - pointer to the current candidate start address
+ *	align - alignment mask
+ * At exit:
+ *	returns TRUE if *sta fits below some area in the subtree
+ *	else returns FALSE and *sta has been moved past the subtree
+ */
+{
+    RM_struct *rm;
+    while (ii)
+    {
+        rm = list + ii;
+        if (rm->rm_last < *sta) return FALSE;	/* all of it is below us */
+        if (len && rm->rm_gap < len && *sta + len > rm->rm_first)
+        {    /* no hole in here is big enough, skip the whole subtree */
+            *sta = (rm->rm_last + align) & ~align;
+            return FALSE;
         }
-        if (end < rm->rm_start )
+        if (rm_fit(list, rm->rm_left, len, sta, align)) return TRUE;
+        if (len ? *sta + len <= rm->rm_start : *sta < rm->rm_start)
+            return TRUE;	/* use sta as start addr */
+        if (RM_END(rm) >= *sta)
         {
-            break;             /* it's not in the table */
+            *sta = RM_END(rm) + align;	/* move to space after */
+            *sta &= ~align;		/* correct the alignment */
         }
-    } while ((rm = rm->rm_next) != 0);
-    return FALSE; /* not in the list */
+        ii = rm->rm_right;
+    }
+    return FALSE;
 }
 
 /**********************************************************************
@@ -304,29 +404,88 @@ int get_free_space(uint32_t len, uint32_t *start, int align)
  */
 {
     uint32_t sta= *start;
-    struct rm_struct *rm;
-    if (rm_control != 0 && (rm = rm_control->top) != 0)
+    if (rm_control != 0 && rm_control->root != 0)
+        rm_fit(rm_control->list, rm_control->root, len, &sta, align);
+    if (sta + len < sta) return FALSE;       /* no room */
+    add_to_reserve(sta,len);         /* add it to the list */
+    *start = sta;                /* pass back start address */
+    return TRUE;                 /* say it's ok */
+}
+
+/**********************************************************************
+ * Get the next reserved area
+ */
+int get_next_reserve(uint32_t addr, uint32_t *start, uint32_t *len)
+/*
+ * At entry:
+ *	addr - address to begin the search
+ *	start - where to put the start of the area found
+ *	len - where to put the length of the area found
+ * At exit:
+ *	returns TRUE and the first area starting at or after addr
+ *	else returns FALSE if there are no more
+ */
+{
+    int ii, fnd=0;
+    RM_struct *list;
+    if (rm_control == 0) return FALSE;
+    list = rm_control->list;
+    ii = rm_control->root;
+    while (ii)
     {
-        do
+        if (list[ii].rm_start >= addr)
+        {
+            fnd = ii;
+            ii = list[ii].rm_left;
+        }
+        else
         {
-            if (!len)
+            ii = list[ii].rm_right;
+        }
+    }
+    if (!fnd) return FALSE;
+    *start = list[fnd].rm_start;
+    *len = list[fnd].rm_len;
+    return TRUE;
+}
+
+/**********************************************************************
+ * Get the free hole at or after an address
+ */
+int get_free_hole(uint32_t addr, uint32_t *start, uint32_t *end)
+/*
+ * At entry:
+ *	addr - address to begin the search
+ *	start - where to put the first free address found
+ *	end - where to put the end (first reserved address) of the hole
+ * At exit:
+ *	returns TRUE and the hole if there is one
+ *	else returns FALSE if everything from addr up is reserved
+ */
+{
+    int ii, fnd=0;
+    RM_struct *list;
+    *end = 0xFFFFFFFFl;
+    if (rm_control != 0 && (ii = rm_control->root) != 0)
+    {
+        list = rm_control->list;
+        while (ii)
+        {    /* find the last area that starts at or before addr */
+            if (list[ii].rm_start <= addr)
             {
-                if (sta < rm->rm_start) break;
+                fnd = ii;
+                ii = list[ii].rm_right;
             }
             else
             {
-                if (sta + len <= rm->rm_start) break; /* use sta as start addr */
-            }
-            if (rm->rm_start+rm->rm_len >= sta)
-            {
-                sta = rm->rm_start+rm->rm_len;  /* move to space after */
-                sta += align;           /* correct the alignment */
-                sta &= ~align;
+                ii = list[ii].rm_left;
             }
-        } while ((rm = rm->rm_next) != 0);        /* skip to next element */
+        }
+        if (fnd && RM_END(list+fnd) > addr)
+            addr = RM_END(list+fnd);	/* addr is reserved, skip the area */
+        if (get_next_reserve(addr, start, end)) *end = *start;
     }
-    if (sta + len < sta) return FALSE;       /* no room */
-    add_to_reserve(sta,len);         /* add it to the list */
-    *start = sta;                /* pass back start address */
-    return TRUE;                 /* say it's ok */
+    if (addr >= *end) return FALSE;
+    *start = addr;
+    return TRUE;
 }
@@ -0,0 +1,211 @@
+/*
+    squeeze.c - Part of llf, a cross linker. Part of the macxx tool chain.
+    Copyright (C) 2008 David Shepperd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>		/* get standard I/O definitions */
+#include <string.h>
+#include "token.h"		/* define compile time constants */
+#include "structs.h"		/* define structures */
+#include "header.h"
+
+/*
+ * Block compressor for -PACK'ed tmp segments.
+ *
+ * This is a plain LZ77 with a byte oriented format, so unpacking is
+ * little more than a series of memcpy's. A block is a list of
+ * sequences, each of which is:
+ *
+ *	token		high nibble is the number of literal bytes, low
+ *			nibble is the match length less SQZ_MINMATCH. A
+ *			nibble of 15 means more length follows as bytes
+ *			added on until one is less than 255.
+ *	literals	copied as is.
+ *	offset		2 bytes, little endian, back from the current
+ *			output position to the start of the match.
+ *
+ * The last sequence has only literals and ends the block. Matches may
+ * overlap their own output, which is how runs of the same byte come out
+ * (offset 1). Matches are found with a single probe of a hash table
+ * of the last position each 4 byte string was seen at.
+ */
+
+#define SQZ_MINMATCH	4
+#define SQZ_HASH_BITS	12
+#define SQZ_MAXOFF	65535
+
+static int32_t sqz_hash[1 << SQZ_HASH_BITS];
+
+static uint32_t get4(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+#define SQZ_HASH(v) ((uint32_t)((v) * 2654435761u) >> (32 - SQZ_HASH_BITS))
+
+static uint8_t *put_len(uint8_t *dst, int32_t len)
+{
+	while ( len >= 255 )
+	{
+		*dst++ = 255;
+		len -= 255;
+	}
+	*dst++ = (uint8_t)len;
+	return dst;
+}
+
+/********************************************************************
+ * Worst case size of a packed block
+ */
+int32_t sqz_bound(int32_t len)
+{
+	return len + len / 255 + 16;
+}
+
+/********************************************************************
+ * Pack a block
+ */
+int32_t sqz_block(const char *src, int32_t len, char *dst)
+/*
+ * At entry:
+ *	src - pointer to data to pack
+ *	len - number of bytes to pack
+ *	dst - pointer to at least sqz_bound(len) bytes
+ * At exit:
+ *	returns the number of bytes written to dst
+ */
+{
+	const uint8_t *ip, *anchor, *iend, *ilimit, *base, *ref;
+	uint8_t *op, *tok;
+	int32_t lit, mlen;
+	uint32_t h;
+
+	base = ip = anchor = (const uint8_t *)src;
+	iend = base + len;
+	ilimit = iend - SQZ_MINMATCH;
+	op = (uint8_t *)dst;
+	memset(sqz_hash, -1, sizeof(sqz_hash));
+	while ( ip < ilimit )
+	{
+		h = SQZ_HASH(get4(ip));
+		ref = sqz_hash[h] >= 0 ? base + sqz_hash[h] : 0;
+		sqz_hash[h] = ip - base;
+		if ( !ref || ip - ref > SQZ_MAXOFF || get4(ref) != get4(ip) )
+		{
+			++ip;
+			continue;
+		}
+		for (mlen = SQZ_MINMATCH; ip + mlen < iend && ref[mlen] == ip[mlen]; ++mlen)
+			;
+		lit = ip - anchor;
+		tok = op++;
+		*tok = (lit < 15 ? lit : 15) << 4;
+		if ( lit >= 15 )
+			op = put_len(op, lit - 15);
+		memcpy(op, anchor, lit);
+		op += lit;
+		*op++ = (uint8_t)(ip - ref);
+		*op++ = (uint8_t)((ip - ref) >> 8);
+		mlen -= SQZ_MINMATCH;
+		*tok |= mlen < 15 ? mlen : 15;
+		if ( mlen >= 15 )
+			op = put_len(op, mlen - 15);
+		ip += mlen + SQZ_MINMATCH;
+		anchor = ip;
+	}
+	lit = iend - anchor;
+	*op++ = (lit < 15 ? lit : 15) << 4;
+	if ( lit >= 15 )
+		op = put_len(op, lit - 15);
+	memcpy(op, anchor, lit);
+	op += lit;
+	return op - (uint8_t *)dst;
+}
+
+/********************************************************************
+ * Unpack a block
+ */
+int32_t unsqz_block(const char *src, int32_t zlen, char *dst, int32_t len)
+/*
+ * At entry:
+ *	src - pointer to packed data
+ *	zlen - number of packed bytes
+ *	dst - pointer to len bytes of output space
+ * At exit:
+ *	returns the number of bytes unpacked or -1 if the block
+ *	is damaged.
+ */
+{
+	const uint8_t *ip, *iend, *ref;
+	uint8_t *op, *oend;
+	int32_t lit, mlen, off;
+	int c;
+
+	ip = (const uint8_t *)src;
+	iend = ip + zlen;
+	op = (uint8_t *)dst;
+	oend = op + len;
+	while ( ip < iend )
+	{
+		c = *ip++;
+		lit = c >> 4;
+		if ( lit == 15 )
+		{
+			do
+			{
+				if ( ip >= iend )
+					return -1;
+				lit += *ip;
+			} while ( *ip++ == 255 );
+		}
+		if ( lit > iend - ip || lit > oend - op )
+			return -1;
+		memcpy(op, ip, lit);
+		op += lit;
+		ip += lit;
+		if ( ip >= iend )
+			break;          /* last sequence has no match */
+		if ( iend - ip < 2 )
+			return -1;
+		off = ip[0] | (ip[1] << 8);
+		ip += 2;
+		mlen = c & 15;
+		if ( mlen == 15 )
+		{
+			do
+			{
+				if ( ip >= iend )
+					return -1;
+				mlen += *ip;
+			} while ( *ip++ == 255 );
+		}
+		mlen += SQZ_MINMATCH;
+		if ( off == 0 || off > op - (uint8_t *)dst || mlen > oend - op )
+			return -1;
+		ref = op - off;
+		if ( off >= mlen )
+		{
+			memcpy(op, ref, mlen);
+			op += mlen;
+		}
+		else
+		{
+			while ( mlen-- )
+				*op++ = *ref++;
+		}
+	}
+	return op - (uint8_t *)dst;
+}
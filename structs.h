@@ -80,6 +80,7 @@ typedef struct fn_struct {
    unsigned fn_option:1;	/* file is an option file 		*/
    unsigned fn_nosym:1;		/* don't put symbols into .SYM file	*/
    unsigned fn_nostb:1;		/* don't put symbols into .STB file	*/
+   int32_t fn_xref_idx;		/* file's -cross index (0 if none yet)	*/
 } FN_struct;
 
 extern FN_struct *xfer_fnd;
@@ -90,6 +91,7 @@ extern FN_struct output_files[OUT_FN_MAX]; /* output file structs */
 #define sec_fp output_files[OUT_FN_SEC].fn_file
 #define abs_fp output_files[OUT_FN_ABS].fn_file
 #define stb_fp output_files[OUT_FN_STB].fn_file
+#define jsn_fp output_files[OUT_FN_JSON].fn_file
 #define tmp_fp output_files[OUT_FN_TMP].fn_file
 extern FN_struct *first_inp;
 extern FN_struct *library( void );
@@ -119,8 +121,29 @@ typedef struct seg_spec_struct {
    unsigned sflg_fit:1;		/* group is to be fit */
    unsigned sflg_stable:1;	/* keep named segments in order */
    unsigned sflg_literal:1;	/* literal pool */
+   unsigned sflg_packed:1;	/* seg_base was chosen by pack_group() */
+   uint32_t seg_fill_used;	/* FIT group: bytes packed */
+   uint32_t seg_fill_free;	/* FIT group: free bytes in the space packed */
+   uint32_t seg_fill_over;	/* FIT group: bytes placed past the TO limit */
+   uint32_t seg_fill_nover;	/* FIT group: number of segments past TO */
 } SEG_spec_struct;
 
+typedef struct xref_blk {
+   struct xref_blk *xb_next;	/* next block of file indexes */
+   int32_t xb_idx[XREF_BLOCK_SIZE]; /* file indexes */
+} XREF_blk;
+
+typedef struct xref_struct {
+   int32_t xr_def;		/* index of defining file (0 if none yet) */
+   int32_t xr_count;		/* number of indexes in the blocks */
+   int32_t xr_words;		/* size of xr_bits in uint32_t's */
+   uint32_t *xr_bits;		/* indexes in the blocks (0 until the first block fills) */
+   XREF_blk *xr_tail;		/* block the next index goes into */
+   XREF_blk xr_head;		/* first block of referencing files */
+} XREF_struct;
+
+extern FN_struct **xref_fnd;	/* file for each -cross file index */
+
 typedef struct ss_struct {
    unsigned  flg_segment:1;	/* this is a segment struct */
    unsigned  flg_symbol:1;	/* this is a symbol struct */
@@ -139,20 +162,23 @@ typedef struct ss_struct {
    unsigned  flg_noout:1;	/* don't output this segment */
    unsigned  flg_nosym:1;	/* don't output this symbol to .SYM file */
    unsigned  flg_literal:1;	/* This symbol is the fake literalPool symbol */
+   unsigned  flg_evaling:1;	/* symbol's expression is being evaluated */
+   unsigned  flg_evaled:1;	/* symbol's expression has been evaluated */
    uint16_t ss_strlen;		/* symbol name string length (also sym ID) */
    int32_t ss_value;		/* symbol value */
    char *ss_string;			/* pointer to ASCII identifier name */
    struct ss_struct *ss_next; 	/* pointer to next node */
    struct ss_struct **ss_prev;	/* pointer to previous structs next ptr */
    struct fn_struct *ss_fnd;	/* pointer to fnd of first reference */
-   struct fn_struct **ss_xref;	/* pointer to cross reference table */
+   struct xref_struct *ss_xref;	/* pointer to cross reference table */
    struct exp_stk *ss_exprs;	/* pointer to expression definition area */
    struct seg_spec_struct *seg_spec; /* pointer to segment to which this symbol "belongs" */
 } SS_struct;
 
 #define ss_ident ss_strlen	/* equate strlen to ident */
 
-extern SS_struct **id_table;  /* pointer to id_table */
+extern SS_struct *get_id( int32_t id );	/* look up an ID number */
+extern void set_id( int32_t id, SS_struct *id_ptr );
 extern SS_struct *first_symbol; /* pointer to first if duplicates */
 extern int16_t new_symbol;		/* symbol insertion flag */
    				/* value (additive) */
@@ -161,16 +187,34 @@ extern int16_t new_symbol;		/* symbol insertion flag */
    				/*   4 - symbol is duplicated */
 
 extern struct ss_struct *group_list_default; /* pointer to default group name */
-extern SS_struct *hash[]; /* hash table is array of pointers */
+typedef struct name_struct {
+   SS_struct *nm_sym;		/* first symbol with this name (0 if none) */
+   uint32_t nm_hash;		/* full 32 bit hash of the name */
+   int32_t nm_len;		/* name length (including the null) */
+   unsigned nm_undef:1;		/* name is on the undefined symbol worklist */
+   char nm_string[4];		/* the name itself (variable length) */
+} Name_t;
+
+typedef struct sym_hash {
+   Name_t *sh_name;		/* interned name (0 if slot empty) */
+   uint32_t sh_hash;		/* copy of sh_name->nm_hash */
+} SymHash_t;
+
+extern SymHash_t *sym_hash;	/* open addressed symbol hash table */
+extern uint32_t sym_hash_size;	/* number of slots (power of 2) */
 extern SS_struct *base_page_nam;
 extern SS_struct *abs_group_nam;
 extern SS_struct *lit_group_nam;
 extern SS_struct *last_seg_ref;
+extern Name_t *name_intern( const char *strng, int err_flag );
 extern SS_struct *sym_lookup( char *strng, int32_t strlen, int err_flag);
+extern SS_struct *sym_lookup_name( Name_t *name, int err_flag );
+extern Name_t **sym_undefined( uint32_t *countp );
 extern SS_struct *sym_delete( SS_struct *old_ptr );
 extern int write_to_symdef( SS_struct *ptr );
 extern void do_xref_symbol( SS_struct *sym_ptr, unsigned int def);
 extern void insert_id( int32_t id, SS_struct *id_ptr);
+extern void release_ids( void );
 extern SEG_spec_struct *get_seg_spec_mem( SS_struct *sym_ptr);
 extern SS_struct *get_symbol_block( int flag );
 extern SS_struct **find_seg_in_group(SS_struct *, SS_struct **);
@@ -212,27 +256,39 @@ typedef struct exp_stk {
 } EXP_stk;
 
 extern int evaluate_expression(EXP_stk *eptr);
+extern void bind_ids(EXPR_token *exp, int32_t len);
+extern void finish_symdefs(void);
 extern void dump_expr(const char *title, EXP_stk *exp);
 
-typedef struct rm_struct {	/* reserved memory list */
+typedef struct rm_struct {	/* reserved memory area (treap node) */
    uint32_t rm_start;	/* start address */
    uint32_t rm_len;	/* length of area to exclude */
-   struct rm_struct *rm_next;	/* pointer to next element */
+   uint32_t rm_first;	/* lowest start address in this subtree */
+   uint32_t rm_last;	/* highest end address (start+len) in this subtree */
+   uint32_t rm_gap;	/* largest hole between areas in this subtree */
+   uint32_t rm_prio;	/* heap priority */
+   int rm_left;		/* index of lower areas (0=none) */
+   int rm_right;	/* index of higher areas (0=none) */
 } RM_struct;
 
 typedef struct rm_control {
-   RM_struct **list;		/* pointer to array of pointers to arrays of RM_struct's */
-   RM_struct *next;		/* next element to use */
-   RM_struct *top;		/* first element in the whole chain */
+   RM_struct *list;		/* array of nodes, entry 0 is unused */
    uint32_t pool_used;	/* total memory used */
+   int root;			/* index of root node (0=empty) */
    int used;			/* number of entries used in the array */
    int size;			/* number of entries avaiable in array */
-   int free;			/* number of free elements in the array */
+   int free;			/* head of list of free'd entries */
+   int count;			/* number of areas in the tree */
 } RM_control;
 
 extern RM_control *rm_control; 	/* reserved memory info */
 extern RM_control *clone_rm_mem(RM_control *rmc);
 extern void free_rm_mem(RM_control **rmcp);
+extern int get_next_reserve(uint32_t addr, uint32_t *start, uint32_t *len);
+extern int get_free_hole(uint32_t addr, uint32_t *start, uint32_t *end);
+extern SS_struct *sort_by_size(SS_struct *first);
+extern SS_struct *sort_by_base(SS_struct *first);
+extern void pack_group(SS_struct *grp_nam, SS_struct **ls, uint32_t bottom);
 
 extern int token_pool_size;
 extern char *token_pool;
@@ -264,10 +320,28 @@ extern int expr_stack_ptr;  /* expression stack pointer */
 extern void puts_map( const char *string, int lines );
 extern int get_c( void );
 extern int get_text( void );
-extern struct fn_struct **get_xref_pool( void );
+extern int map_text( FN_struct *fnd );
+extern void unmap_text( void );
+extern int libidx_open( FN_struct *fnd );
+extern void libidx_close( void );
+extern int libidx_build( FN_struct *fnd );
+extern FN_struct *libidx_library( void );
+extern char *get_xref_pool( int size );
 
 extern const char *err2str( int num );
+extern void image_put( uint32_t addr, const uint8_t *from, int len );
+extern const uint8_t *image_run( uint32_t *addr, int *len );
+extern void image_free( void );
+extern int32_t sqz_bound( int32_t len );
+extern int32_t sqz_block( const char *src, int32_t len, char *dst );
+extern int32_t unsqz_block( const char *src, int32_t zlen, char *dst, int32_t len );
+extern FILE *wrt_open( const char *name, const char *mode );
+extern void jsn_file( struct fn_struct *fnd );
+extern void wrt_finish( void );
+extern int wrk_count( void );
+extern void wrk_run( int jobs, void (*job)(void *arg, int job), void *arg );
 extern void write_to_tmp( int typ, int32_t itm_cnt, char *itm_ptr, int itm_siz );
+extern void finish_tmp_file( void );
 extern int exprs( int flag );
 
 extern char def_ob[],def_lb[],def_obj[],def_stb[];
@@ -289,6 +363,7 @@ extern void lap_timer( char *str );
 #endif
 extern int lc( void );
 extern void outx_init( void );
+extern void outx_image( void );
 extern void seg_locate( void );
 extern void termsym( int32_t taddr );
 extern void flushsym( int mode );
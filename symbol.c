@@ -18,18 +18,40 @@
 
 /********************************************************************
  *
- * This module does all the symbol table managment. The symbol table
- * storage technique used here is the chained hash table (see Compiler
- * Writing, Tremblay & Sorenson). The hash table size is chosen here to
- * quite large since memory is not as much at a premium on the VAX as on
- * other computers (i.e. PDP-11). You may consider reducing the hash table
- * size if you are to port this to a memory limited system.
- * Tremblay/Sorenson suggest that the hash table size be a prime number. 
+ * This module does all the symbol table managment. Every global name
+ * is interned exactly once in a name arena: a Name_t holding the
+ * name's 32 bit hash, its length and the string itself, allocated
+ * from large blocks that are never moved or freed. The Name_t is the
+ * handle for the name. ss_string of every symbol in the table points
+ * at the interned string, so the same name seen in any number of files
+ * occupies memory only once.
+ *
+ * The names are indexed by an open addressed hash table with linear
+ * probing. Each slot holds the handle and a copy of its hash so a probe
+ * only has to compare strings when the hashes match. The table size is
+ * a power of 2 and the table is doubled (and rehashed) whenever it
+ * becomes half full. Names are never removed, so there are no deleted
+ * slots to deal with.
+ *
+ * Symbols with a name hang off the Name_t through nm_sym. Symbols that
+ * have the same name (duplicate segment names) are kept in a chain
+ * through ss_next, in the order they were added, with flg_more set in
+ * all but the last. The ss_prev of the first in the chain points at
+ * nm_sym, which never moves, so a rehash doesn't touch the symbols.
+ * Once a caller has a handle, finding its symbol is a pointer fetch.
+ *
+ * Names whose first symbol may be an undefined global are kept on a
+ * worklist. A name goes on it when its first symbol is created and
+ * comes off the next time sym_undefined() finds it defined, a segment,
+ * a group or already claimed by a library. Library resolution walks
+ * this list, so its cost follows the number of outstanding references
+ * rather than the size of the symbol table or of the library.
  *
  *******************************************************************/
 
 #include <stdio.h>		/* get standard I/O definitions */
 #include <string.h>
+#include <stddef.h>
 #include "token.h"		/* define compile time constants */
 #include "structs.h"		/* define structures */
 #include "header.h"
@@ -46,7 +68,14 @@ extern int hashit();        /* hashing routine */
 /* Static Globals */
 
 int32_t sym_pool_used;
-SS_struct *hash[HASH_TABLE_SIZE];  /* hash table */
+SymHash_t *sym_hash;        /* hash table */
+uint32_t sym_hash_size;     /* number of slots in hash table */
+static uint32_t sym_hash_used;  /* slots in use */
+static char *name_pool;     /* pointer to next free byte in name arena */
+static int name_pool_size;  /* number of bytes left in name arena */
+static Name_t **undef_list; /* undefined symbol worklist */
+static uint32_t undef_count;    /* number of entries in undef_list */
+static uint32_t undef_size; /* size of undef_list */
 SS_struct *symbol_pool=0; /* pointer to next free symbol space */
 int symbol_pool_size=0;     /* number of symbol spaces left */
 SS_struct *first_symbol=0; /* pointer to first symbol of 'duplicate' list */
@@ -74,7 +103,7 @@ struct ss_struct *get_symbol_block( int flag )
     {
         int t = 256*sizeof(struct ss_struct);
         sym_pool_used += t;
-        symbol_pool = (struct ss_struct *)MEM_alloc(t);
+        symbol_pool = (struct ss_struct *)MEM_pool(t);
         symbol_pool_size = 256;
     }
     if (!flag) return(symbol_pool);
@@ -82,6 +111,101 @@ struct ss_struct *get_symbol_block( int flag )
     return(symbol_pool++);   /* get pointer to free space */
 }
 
+/************************************************************************
+ * (Re)size the hash table
+ */
+static void sym_rehash( void )
+/*
+ * At entry:
+ *	no requirements. sym_hash may be 0 if no table yet.
+ * At exit:
+ *	sym_hash points to a new table, twice the size of the old one
+ *	(HASH_TABLE_SIZE if there was none), so it is again at most half
+ *	full. All the names have been moved to the new table.
+ */
+{
+    SymHash_t *old,*sh,*nh;
+    uint32_t ii,jj,old_size,new_size,mask;
+    old = sym_hash;
+    old_size = sym_hash_size;
+    new_size = old_size ? old_size : HASH_TABLE_SIZE;
+    while (sym_hash_used*2 >= new_size) new_size <<= 1;
+    sym_pool_used += new_size*sizeof(SymHash_t);
+    sym_hash = (SymHash_t *)MEM_alloc(new_size*sizeof(SymHash_t));
+    sym_hash_size = new_size;
+    mask = new_size-1;
+    for (ii=0,sh=old; ii < old_size; ++ii,++sh)
+    {
+        if (sh->sh_name == 0) continue;  /* empty */
+        for (jj=sh->sh_hash&mask;;jj=(jj+1)&mask)
+        {
+            nh = sym_hash+jj;
+            if (nh->sh_name == 0) break;
+        }
+        *nh = *sh;
+    }
+    if (old != 0)
+    {
+        sym_pool_used -= old_size*sizeof(SymHash_t);
+        MEM_free((char *)old);
+    }
+    return;
+}
+
+/************************************************************************
+ * Intern a name
+ */
+Name_t *name_intern( const char *strng, int err_flag )
+/*
+ * At entry:
+ *	strng - pointer to null terminated name
+ *	err_flag:
+ *		0 = just look for the name, don't add it
+ *		1 = add the name to the arena if not already there
+ * At exit:
+ *	returns the name's handle. If err_flag is 0 and the name has
+ *	not been interned, returns NULL.
+ */
+{
+    SymHash_t *sh;
+    Name_t *nm;
+    uint32_t ii,mask,hv;
+    int32_t len;
+    int need;
+    if (sym_hash == 0) sym_rehash();
+    hv = hashit32(strng,&len);
+    mask = sym_hash_size-1;
+    for (ii=hv&mask;;ii=(ii+1)&mask)
+    {
+        sh = sym_hash+ii;
+        if ((nm = sh->sh_name) == 0) break;     /* end of the probe */
+        if (sh->sh_hash == hv && nm->nm_len == len+1 &&
+            memcmp(nm->nm_string,strng,len) == 0)
+            return(nm);         /* found it */
+    }
+    if (!err_flag) return(NULL);
+    need = (offsetof(Name_t,nm_string)+len+1+sizeof(char *)-1)&-sizeof(char *);
+    if (need < (int)sizeof(Name_t)) need = sizeof(Name_t);
+    if (name_pool_size < need)
+    {
+        int t = NAME_POOL_SIZE;
+        if (need > t) t = need;
+        sym_pool_used += t;
+        name_pool = MEM_pool(t);
+        name_pool_size = t;
+    }
+    nm = (Name_t *)name_pool;
+    name_pool += need;
+    name_pool_size -= need;
+    nm->nm_hash = hv;
+    nm->nm_len = len+1;
+    memcpy(nm->nm_string,strng,len);   /* arena is 0'd so it's terminated */
+    sh->sh_name = nm;
+    sh->sh_hash = hv;
+    if (++sym_hash_used*2 > sym_hash_size) sym_rehash();
+    return(nm);
+}
+
 /*******************************************************************
  *
  * Symbol table lookup and insert
@@ -106,88 +230,134 @@ SS_struct *sym_lookup(
  * 	symbol block if symbol not found or old symbol block if symbol
  * 	already in symbol table. If err_flag == 0, then returns
  * 	NULL if symbol not found in the symbol table, else returns with
- * 	pointer to old symbol block.
+ * 	pointer to old symbol block. The caller's string is not kept,
+ *	the symbol's ss_string points at the interned copy.
+ *********************************************************************/
+{
+    Name_t *nm;
+    first_symbol = NULL;
+    new_symbol = NULL;
+    if (slen <= 0) return(NULL); /* not there, don't insert it */
+    if ((nm = name_intern(strng,err_flag != 0)) == 0) return(NULL);
+    return(sym_lookup_name(nm,err_flag));
+}
+
+/*******************************************************************
+ *
+ * Symbol table lookup and insert by handle
+ */
+SS_struct *sym_lookup_name( Name_t *nm, int err_flag )
+/*
+ * At entry:
+ *	nm - handle of an interned name
+ *      err_flag - same as sym_lookup()
+ * At exit:
+ *	same as sym_lookup()
  *********************************************************************/
 {
-    int i,condit;
     struct ss_struct *st,**last,*new,*old=0;
     first_symbol = NULL;
     new_symbol = NULL;
 
 /* Check for presence of free symbol block and add one if none */
 
-    if (slen <= 0) return(NULL); /* not there, don't insert it */
     if (symbol_pool_size <= 0)
     {
         if (!get_symbol_block(0)) return(NULL);
     }
 
-/* hash the hash value */
-
-    i = hashit(strng,HASH_TABLE_SIZE);
+/* If there is no symbol with this name yet then this is a table miss, */
+/* add a new symbol */
 
-/* Pick up the pointer from the hash table to the symbol block */
-/* If NULL then this is a table miss, add a new entry to the hash table */
-
-    if ((st = hash[i]) == 0)
+    if ((st = nm->nm_sym) == 0)
     {
         if (!err_flag) return(NULL); /* no symbol */
-        st = hash[i] = symbol_pool++; /* pick up pointer to new symbol block */
+        st = nm->nm_sym = symbol_pool++; /* pick up pointer to new symbol block */
         --symbol_pool_size;   /* take from total */
-        st->ss_string = strng;    /* set the string constant */
-        st->ss_strlen = slen;   /* set the length of the string */
-        st->ss_prev = hash+i; /* ptr to place that holds ptr to us */
+        st->ss_string = nm->nm_string;    /* set the string constant */
+        st->ss_strlen = nm->nm_len;   /* set the length of the string */
+        st->ss_prev = &nm->nm_sym; /* ptr to place that holds ptr to us */
         new_symbol = 3;       /* 3 = symbol added and is first in the chain */
+        if (!nm->nm_undef)
+        {               /* put it on the worklist */
+            if (undef_count >= undef_size)
+            {
+                int t = undef_size ? undef_size/2 : 1024;
+                sym_pool_used += t*sizeof(Name_t *);
+                undef_size += t;
+                undef_list = (Name_t **)MEM_realloc((char *)undef_list,undef_size*sizeof(Name_t *));
+            }
+            undef_list[undef_count++] = nm;
+            nm->nm_undef = 1;
+        }
         return(st);       /* return pointing to new block */
     }
 
-/* This is a table collision. Its linear search time from here on. */
-/* The symbols are stored ordered alphabetically in the list. The */
-/* variable "last" is a pointer to a pointer that says where to */
-/* deposit the backlink. If the result of a string compare denotes */
-/* equality, the routine exits pointing to the found block. If the */
-/* user's string is less than the one tested against, then a new block */
-/* is inserted in front of the tested block else a new one is added at */
-/* the end of the list */
+/* The name is present. All the symbols in the chain have the same name. */
+/* Unless a duplicate is being asked for, the first one is it. Else the */
+/* routine exits pointing to the first one not yet defined or adds a new */
+/* block at the end of the chain. The variable "last" is a pointer to a */
+/* pointer that says where to deposit the backlink. */
 
-    last = hash + i;     /* remember place to stuff backlink */
+    last = &nm->nm_sym;      /* remember place to stuff backlink */
 
     while (1)
-    {           /* loop through the whole ordered list */
-        condit = strcmp(strng,st->ss_string);
-        if (condit < 0) break; /* not there if user's is less */
-        if (condit == 0)
-        {
-            if (err_flag != 2) return(st); /* found it */
-            if (!st->flg_defined) return(st); /* found it */
-            new_symbol |= 4;   /* signal duplicate symbol to be added */
-            if (!first_symbol) first_symbol = st; /* record first entry */
-        }
+    {           /* loop through the whole chain */
+        if (err_flag != 2) return(st); /* found it */
+        if (!st->flg_defined) return(st); /* found it */
+        new_symbol |= 4;   /* signal duplicate symbol to be added */
+        if (!first_symbol) first_symbol = st; /* record first entry */
         last = &(old=st)->ss_next;  /* next place to store backlink */
         if ((st = st->ss_next) == 0) break; /* get link to next block, exit if NULL */
     }
 
-    if (!err_flag) return(NULL); /* not there, don't insert one */
-
-/* Have to insert a new block in between two others or at the end of the */
-/* list. (st is NULL if inserting at the end). */
+/* Have to add a new block to the end of the chain. */
 
     new_symbol |= 1;     /* signal that we've added a symbol */
     new = symbol_pool++;     /* get pointer to free space */
     --symbol_pool_size;      /* count it down */
-    if (new_symbol & 4)
-    {    /* duplicate symbol being added */
-        old->flg_more = 1;    /* signal that there's another symbol */
-    }
+    old->flg_more = 1;       /* signal that there's another symbol */
     *last = new;         /* point previous block to the new one (backlink) */
     new->ss_prev = last;     /* keep the ptr to the place holding ptr to us */
-    new->ss_next = st;       /* point to the following one */
-    new->ss_string = strng;  /* point to the string */
-    new->ss_strlen = slen; /* record the string length */
-    if (st != 0) st->ss_prev = &new->ss_next; /* next guy gets backlink to us */
+    new->ss_next = 0;        /* it's the last one */
+    new->ss_string = nm->nm_string;  /* point to the string */
+    new->ss_strlen = nm->nm_len; /* record the string length */
     return(new);         /* return pointing to new block */
 }    
 
+/*********************************************************************
+ * Get the undefined symbol worklist
+ */
+Name_t **sym_undefined( uint32_t *countp )
+/*
+ * At entry:
+ *	countp - pointer to place to deposit number of entries
+ * At exit:
+ *	returns pointer to the worklist. It has been purged of any name
+ *	whose first symbol is no longer an undefined global waiting for
+ *	a library, so each of the *countp entries is one. The list is
+ *	only valid until the next symbol is added.
+ */
+{
+    Name_t **src,**dst,*nm;
+    SS_struct *st;
+    uint32_t ii;
+    for (ii=0,src=dst=undef_list; ii < undef_count; ++ii)
+    {
+        nm = *src++;
+        if ((st = nm->nm_sym) == 0 || st->flg_defined || st->flg_segment ||
+            st->flg_group || st->flg_libr)
+        {
+            nm->nm_undef = 0;       /* off the list */
+            continue;
+        }
+        *dst++ = nm;
+    }
+    undef_count = dst-undef_list;
+    *countp = undef_count;
+    return(undef_list);
+}
+
 /*********************************************************************
  * Delete symbol from symbol table.
  */
@@ -197,87 +367,132 @@ SS_struct *sym_delete( SS_struct *old_ptr )
  *	old_ptr - pointer to symbol block to delete
  * At exit:
  *	symbol removed from the symbol table if present. Routine always
- *	returns old_ptr.
+ *	returns old_ptr. The name stays interned.
  */
 {
-    int i;
-    struct ss_struct *st,**last;
-
-/* compute the hash value */
-
-    i = hashit(old_ptr->ss_string,HASH_TABLE_SIZE);
 
-/* Pick up the pointer from the hash table to the symbol block */
-/* If NULL then this is a table miss, nothing to delete */
+/* A symbol in the table always has a backlink, either to its name's */
+/* nm_sym or to the previous symbol's ss_next. Pluck it out by patching */
+/* the link fields. */
 
-    if ((st = hash[i]) == 0) return(old_ptr); /* he can have the old one */
-
-/* There is a symbol in the symbol table pointed to by the hash table. */
-/* The first entry is special in that the backlink is actually the hash */
-/* table itself. Otherwise, this routine finds the occurance of the old_ptr */
-/* in the chain and plucks it out by patching the link fields. */
+    if (old_ptr->ss_prev == 0) return(old_ptr); /* not in the table */
+    *old_ptr->ss_prev = old_ptr->ss_next; /* pluck it out, set the backlink */
+    if (old_ptr->ss_next != 0) old_ptr->ss_next->ss_prev = old_ptr->ss_prev;
+    old_ptr->ss_next = 0;
+    old_ptr->ss_prev = 0;
+    return(old_ptr);     /* he can have the old block */
+}    
 
-    last = hash + i;     /* place to stash backlink */
+FN_struct **xref_fnd;		/* file for each -cross file index */
+static int32_t xref_fnd_count;	/* indexes handed out (0 is never used) */
+static int32_t xref_fnd_size;	/* room in xref_fnd */
 
-    while (1)
-    {           /* loop through the whole ordered list */
-        if (st == old_ptr)
+/*********************************************************************
+ * Give a file its -cross index
+ */
+static int32_t xref_index( FN_struct *fnd )
+{
+    FN_struct **new_fnd;
+    if (xref_fnd_count+1 >= xref_fnd_size)
+    {
+        xref_fnd_size = xref_fnd_size ? xref_fnd_size*2 : 64;
+        new_fnd = (FN_struct **)MEM_alloc(xref_fnd_size*sizeof(FN_struct *));
+        misc_pool_used += xref_fnd_size*sizeof(FN_struct *);
+        if (xref_fnd)
         {
-            *last = old_ptr->ss_next; /* pluck it out, set the backlink */
-            if (old_ptr->ss_next != 0) old_ptr->ss_next->ss_prev = last;
-            old_ptr->ss_next = 0;
-            old_ptr->ss_prev = 0;
-            return(old_ptr);   /* he can have the old block */
+            memcpy(new_fnd,xref_fnd,(xref_fnd_count+1)*sizeof(FN_struct *));
+            MEM_free(xref_fnd);
+            misc_pool_used -= xref_fnd_size/2*sizeof(FN_struct *);
         }
-        last = &st->ss_next;  /* next place to store backlink */
-        if ((st = st->ss_next) == 0) break; /* get link to next block, exit if NULL */
+        xref_fnd = new_fnd;
     }
-    return(old_ptr);     /* not in the table, give 'em the old one */
-}    
+    xref_fnd[++xref_fnd_count] = fnd;
+    return (fnd->fn_xref_idx = xref_fnd_count);
+}
 
-void do_xref_symbol( SS_struct *sym_ptr, unsigned int defined)
+/*********************************************************************
+ * Add a file index to a symbol's cross reference bitset
+ */
+static void xref_bit( XREF_struct *xr, int32_t idx )
 {
-    struct fn_struct **fnp_ptr;
-    int i=0,j=0;
-    if ((fnp_ptr = sym_ptr->ss_xref) == 0)
+    int32_t words;
+    if ((words = idx/32+1) > xr->xr_words)
     {
-        fnp_ptr = sym_ptr->ss_xref = get_xref_pool();
-        *fnp_ptr = (struct fn_struct *)-1l; /* reserve first place for "defined in" file */
+        if (words < xref_fnd_size/32+1) words = xref_fnd_size/32+1;
+        if (xr->xr_bits)
+            xr->xr_bits = (uint32_t *)MEM_realloc((char *)xr->xr_bits,words*sizeof(uint32_t));
+        else
+            xr->xr_bits = (uint32_t *)MEM_alloc(words*sizeof(uint32_t));
+        memset((char *)(xr->xr_bits+xr->xr_words),0,(words-xr->xr_words)*sizeof(uint32_t));
+        xref_pool_used += (words-xr->xr_words)*sizeof(uint32_t);
+        xr->xr_words = words;
     }
-    if (*fnp_ptr == (struct fn_struct *)-1l && defined != 0)
+    xr->xr_bits[idx/32] |= (uint32_t)1 << (idx%32);
+}
+
+/*********************************************************************
+ * Record a file's reference to (or definition of) a symbol
+ */
+void do_xref_symbol( SS_struct *sym_ptr, unsigned int defined)
+/*
+ * At entry:
+ *	sym_ptr - pointer to symbol
+ *	defined - non-zero if current_fnd defines the symbol
+ * At exit:
+ *	current_fnd is in the symbol's cross reference. The first file to
+ *	define it is kept apart, to be listed first. The others are kept
+ *	once each in the order first seen. If the defining file had
+ *	already referenced the symbol, that reference stays in the blocks
+ *	and the listings skip it.
+ *
+ * Each file gets a small dense index the first time it shows up here.
+ * While the indexes fit in the first block, a duplicate is found by
+ * looking through it. Once it fills, the indexes are also kept in a
+ * bitset, so the check stays one bit test however many files refer
+ * to the symbol, in whatever order they come.
+ */
+{
+    XREF_struct *xr;
+    XREF_blk *blk;
+    int32_t idx;
+    int ii;
+
+    if ((idx = current_fnd->fn_xref_idx) == 0) idx = xref_index(current_fnd);
+    if ((xr = sym_ptr->ss_xref) == 0)
     {
-        *fnp_ptr = current_fnd;   /* defined file is first in the list */
-        j++;
+        xr = sym_ptr->ss_xref = (XREF_struct *)get_xref_pool(sizeof(XREF_struct));
+        xr->xr_tail = &xr->xr_head;
     }
-    if (j != 0)
+    if (idx == xr->xr_def) return;      /* already listed first */
+    if (defined && !xr->xr_def)
     {
-        fnp_ptr++;        /* skip the defined file */
-        i++;          /* count it */
-        while (*fnp_ptr != 0 && *fnp_ptr != current_fnd)
-        {
-            i++;
-            fnp_ptr++;
-            if (i < XREF_BLOCK_SIZE-1) continue;
-            if ((fnp_ptr= *((struct fn_struct ***)fnp_ptr)) == 0) return;
-            i = 0;
-            continue;
-        }
-        if (*fnp_ptr == current_fnd) *fnp_ptr = (struct fn_struct *)-1l;
+        xr->xr_def = idx;        /* defined file is first in the list */
         return;
     }
-    while (*fnp_ptr != 0 )
+    if (xr->xr_bits)
     {
-        if (*fnp_ptr++ == current_fnd) return;    /* already referenced */
-        i++;
-        if ( i < XREF_BLOCK_SIZE-1) continue;
-        if (*fnp_ptr == 0)
-        {  /* off the end and no more? */
-            *((struct fn_struct ***)fnp_ptr) = get_xref_pool(); /* get a new block of memory */
+        if (idx/32 < xr->xr_words && (xr->xr_bits[idx/32] & ((uint32_t)1 << (idx%32))))
+            return;              /* already referenced */
+    }
+    else
+    {
+        for (ii=0; ii < xr->xr_count; ++ii)
+            if (xr->xr_head.xb_idx[ii] == idx) return;  /* already referenced */
+    }
+    ii = xr->xr_count%XREF_BLOCK_SIZE;
+    if (!ii && xr->xr_count)
+    {  /* tail block is full */
+        blk = (XREF_blk *)get_xref_pool(sizeof(XREF_blk));
+        xr->xr_tail->xb_next = blk;
+        xr->xr_tail = blk;
+        if (!xr->xr_bits)
+        {   /* from here on duplicates are found in the bitset */
+            for (ii=0; ii < XREF_BLOCK_SIZE; ++ii) xref_bit(xr,xr->xr_head.xb_idx[ii]);
+            ii = 0;
         }
-        fnp_ptr = *((struct fn_struct ***)fnp_ptr);
-        i = 0;
-        continue;
     }
-    *fnp_ptr = current_fnd;  /* cross reference the symbol */
+    xr->xr_tail->xb_idx[ii] = idx;  /* cross reference the symbol */
+    ++xr->xr_count;
+    if (xr->xr_bits) xref_bit(xr,idx);
     return;
 }
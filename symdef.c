@@ -96,6 +96,70 @@ int write_to_symdef( SS_struct *ptr )
     return TRUE;
 }
 
+/************************************************************************
+ * Bind an expression's ID references to their symbols
+ */
+void bind_ids( EXPR_token *exp, int32_t len )
+/*
+ * At entry:
+ *	exp - pointer to expression tokens
+ *	len - number of tokens
+ *	ID table still holds the current file's ID's
+ * At exit:
+ *	all EXPR_IDENT terms have been changed to EXPR_SYM terms
+ */
+{
+    SS_struct *sym_ptr;
+    for (; len > 0; --len, ++exp)
+    {
+        if (exp->expr_code != EXPR_IDENT) continue;
+        if ((sym_ptr = get_id(exp->ss_id)) == 0)
+        {
+            sprintf(emsg,"Ident %d not defined but used in expression in \"%s\"",
+                    (int)exp->ss_id,current_fnd->fn_buff);
+            err_msg(MSG_ERROR,emsg);
+            exp->expr_code = EXPR_VALUE;    /* so it won't accvio */
+            exp->expr_value = 0;
+            continue;
+        }
+        exp->expr_code = EXPR_SYM;
+        exp->ss_ptr = sym_ptr;
+    }
+    return;
+}
+
+static struct sym_def *sym_file_start;
+
+/************************************************************************
+ * Bind the ID's in the symbol definitions made by the current file
+ */
+void finish_symdefs( void )
+/*
+ * At entry:
+ *	called at the end of each input file
+ * At exit:
+ *	none of the expressions written by write_to_symdef() refer to
+ *	the ID table any more.
+ */
+{
+    struct sym_def *def;
+    struct exp_stk *exp;
+    def = sym_file_start ? sym_file_start : (struct sym_def *)sym_top;
+    while (def != 0 && def != sym_pool)
+    {
+        if (def->size == TOKEN_LINK)
+        {
+            def = (struct sym_def *)def->ptr;
+            continue;
+        }
+        exp = (struct exp_stk *)(def+1);
+        bind_ids(exp->ptr,exp->len);
+        def = (struct sym_def *)((char *)def + def->size);
+    }
+    sym_file_start = sym_pool;
+    return;
+}
+
 /**********************************************************************
  * Read a bunch of data from sym_def file
  */
@@ -169,7 +233,7 @@ int ev_exp( struct exp_stk *eptr )
         case EXPR_IDENT:
 			{         /* 1 level of indirection */
                 tos->expr_code = EXPR_SYM;      /* signal its now a sym */
-				tos->ss_ptr = id_table[tos->ss_id]; /* * ((int)tos->expr_ptr + id_table); */
+				tos->ss_ptr = get_id(tos->ss_id);
             }
             /* fall through to EXPR_SYM */
         case EXPR_SYM:
@@ -212,9 +276,26 @@ int ev_exp( struct exp_stk *eptr )
                     {
                         struct exp_stk *lnk;
                         lnk = sym_ptr->ss_exprs;
-                        if (!qual_tbl[QUAL_REL].present || sym_ptr->flg_local)
+                        if (sym_ptr->flg_evaling)
                         {
-                            if (ev_exp(lnk) == 0)
+                            sprintf(emsg,
+                                    "Circular definition of symbol {%s}",
+                                    sym_ptr->ss_string);
+                            err_msg(MSG_WARN,emsg);
+                            tos->expr_code = EXPR_VALUE;
+                            tos->expr_value = 0;
+                            ++err_cnt;
+                            ++tos;
+                            break;
+                        }
+                        if (!sym_ptr->flg_evaled &&
+                            (!qual_tbl[QUAL_REL].present || sym_ptr->flg_local))
+                        {
+                            int sts;
+                            sym_ptr->flg_evaling = 1;
+                            sts = ev_exp(lnk);
+                            sym_ptr->flg_evaling = 0;
+                            if (sts == 0)
                             {    /* collapse expression */
                                 sprintf(emsg,
                                         "Nested expression error in definition of symbol {%s}",
@@ -730,6 +811,140 @@ int evaluate_expression(struct exp_stk *eptr)
     return FALSE;
 }
 
+/********************************************************************
+ * Evaluate one symbol's definition and cache the result.
+ */
+static int define_symbol( SS_struct *sym_ptr )
+/*
+ * At entry:
+ *	sym_ptr - symbol whose ss_exprs is to be evaluated
+ * At exit:
+ *	returns TRUE if the symbol is defined. The expression has been
+ *	collapsed in place and, if not -REL, the value is in ss_value.
+ *	flg_evaled is set so it is never evaluated again.
+ */
+{
+    struct exp_stk *exp;
+    int sts = 1;
+    sym_ptr->flg_evaled = 1;
+    if ((exp=sym_ptr->ss_exprs) != 0 && exp->len != 0)
+    {
+        sym_ptr->flg_evaling = 1;
+        sts = evaluate_expression(exp);
+        sym_ptr->flg_evaling = 0;
+        if (!sts)
+        {
+            sym_ptr->flg_defined = 0;   /* say symbol isn't defined */
+            sprintf(emsg,"\twhile defining symbol {%s%s%s\n",
+                    sym_ptr->ss_string,"} from file ",
+                    sym_ptr->ss_fnd->fn_name_only);
+            err_msg(MSG_CONT,emsg);
+        }
+        else
+        {
+            if (!qual_tbl[QUAL_REL].present)
+            {
+                sym_ptr->flg_exprs = 0;  /* reset the expression flag */
+                sym_ptr->flg_abs = 1;    /* signal symbol is resolved */
+                sym_ptr->ss_value = token_value;
+            }
+        }
+    }
+    return sts;
+}
+
+typedef struct def_frame
+{
+    SS_struct *sym;      /* symbol waiting for its dependencies */
+    int next;            /* next term of its expression to look at */
+} DEF_frame;
+
+static DEF_frame *def_stack;
+static int def_stack_size;
+
+/********************************************************************
+ * Return the symbol a term refers to if it has to be defined first.
+ */
+static SS_struct *def_depends( EXPR_token *ex )
+{
+    SS_struct *sym_ptr;
+    if (ex->expr_code == EXPR_IDENT)
+        sym_ptr = get_id(ex->ss_id);
+    else if (ex->expr_code == EXPR_SYM)
+        sym_ptr = ex->ss_ptr;
+    else
+        return 0;
+    if (sym_ptr == 0 || !sym_ptr->flg_defined || sym_ptr->flg_segment ||
+        !sym_ptr->flg_exprs || sym_ptr->ss_exprs == 0 ||
+        sym_ptr->flg_evaled || sym_ptr->flg_evaling)
+        return 0;
+    if (qual_tbl[QUAL_REL].present && !sym_ptr->flg_local)
+        return 0;           /* ev_exp() leaves these alone */
+    return sym_ptr;
+}
+
+/********************************************************************
+ * Define a symbol after all the symbols its definition uses.
+ */
+static int resolve_symbol( SS_struct *sym_ptr )
+/*
+ * At entry:
+ *	sym_ptr - symbol to define
+ * At exit:
+ *	returns TRUE if the symbol is defined.
+ *
+ * The symbols an expression refers to are walked depth first with an
+ * explicit stack and each is defined (see define_symbol()) after the
+ * symbols it refers to. So by the time ev_exp() gets to a reference,
+ * it finds the value already there instead of collapsing the
+ * referenced definition itself, and long chains of equates don't
+ * recurse. A symbol found again while it is still on the stack is part
+ * of a loop. It is left for ev_exp() to report as a circular definition.
+ */
+{
+    int sp, sts = 1;
+    DEF_frame *fp;
+    SS_struct *dep;
+
+    if (def_stack_size == 0)
+    {
+        def_stack_size = 64;
+        symdef_pool_used += def_stack_size*sizeof(DEF_frame);
+        def_stack = (DEF_frame *)MEM_alloc(def_stack_size*sizeof(DEF_frame));
+    }
+    sp = 0;
+    def_stack[0].sym = sym_ptr;
+    def_stack[0].next = 0;
+    sym_ptr->flg_evaling = 1;
+    while (sp >= 0)
+    {
+        fp = def_stack+sp;
+        dep = 0;
+        while (fp->next < fp->sym->ss_exprs->len)
+        {
+            if ((dep = def_depends(fp->sym->ss_exprs->ptr+fp->next++)) != 0) break;
+        }
+        if (dep)
+        {
+            if (sp+1 >= def_stack_size)
+            {
+                symdef_pool_used += def_stack_size*sizeof(DEF_frame);
+                def_stack_size *= 2;
+                def_stack = (DEF_frame *)MEM_realloc((char *)def_stack, def_stack_size*sizeof(DEF_frame));
+            }
+            ++sp;
+            def_stack[sp].sym = dep;
+            def_stack[sp].next = 0;
+            dep->flg_evaling = 1;
+            continue;
+        }
+        fp->sym->flg_evaling = 0;
+        sts = define_symbol(fp->sym);
+        --sp;
+    }
+    return sts;
+}
+
 /********************************************************************
  * Do symbol definitions.
  */
@@ -748,9 +963,7 @@ void symbol_definitions( void )
     rewind_sym();        /* rewind the symbol file */
     while (1)
     {
-        struct exp_stk *exp;
         int sts;
-        sts = 1;          /* assume we're gonna make stb */
         sym_ptr = read_from_sym();
         if (sym_ptr == (struct ss_struct *)0)
         {
@@ -773,27 +986,12 @@ void symbol_definitions( void )
 			   sym_ptr->ss_exprs ? sym_ptr->ss_exprs->len : 0
 			   );
 #endif
-        if ((exp=sym_ptr->ss_exprs) != 0 && exp->len != 0)
-        {
-            if (!evaluate_expression(exp))
-            {
-                sts = 0;        /* no stb */
-                sym_ptr->flg_defined = 0;   /* say symbol isn't defined */
-                sprintf(emsg,"\twhile defining symbol {%s%s%s\n",
-                        sym_ptr->ss_string,"} from file ",
-                        sym_ptr->ss_fnd->fn_name_only);
-                err_msg(MSG_CONT,emsg);
-            }
-            else
-            {
-                if (!qual_tbl[QUAL_REL].present)
-                {
-                    sym_ptr->flg_exprs = 0;  /* reset the expression flag */
-                    sym_ptr->flg_abs = 1;    /* signal symbol is resolved */
-                    sym_ptr->ss_value = token_value;
-                }
-            }
-        }
+        if (sym_ptr->flg_evaled)
+            sts = sym_ptr->flg_defined; /* already done as another's dependency */
+        else if (sym_ptr->ss_exprs != 0 && sym_ptr->ss_exprs->len != 0)
+            sts = resolve_symbol(sym_ptr);
+        else
+            sts = define_symbol(sym_ptr);
         if (sts && !sym_ptr->flg_local && outxsym_fp != 0 && !sym_ptr->ss_fnd->fn_nostb)
         {
             outsym_def(sym_ptr,output_mode);   /* output the definition expression */
@@ -846,7 +1044,7 @@ void dump_expr( const char *title, EXP_stk *exp )
         switch (ex->expr_code)
         {
         case EXPR_IDENT:
-			sym_ptr = id_table[ex->ss_id]; /* * ((int)ex->expr_ptr + id_table); */
+			sym_ptr = get_id(ex->ss_id);
 			if (sym_ptr != 0 && sym_ptr->ss_string != 0)
 			{
 				printf("\tEXPR_IDENT %d. Value %d. Points to symbol %s\n",
@@ -0,0 +1,92 @@
+#!/bin/sh
+# check.sh - link the test inputs and compare the outputs byte for byte
+# with those written by the original llf. Run from the tests directory
+# as "./check.sh [llf]" or from the top with "make -f Makefile.linux check".
+#
+# vrep.ol   - 249 literal bytes then repeated data items. The first
+#             .vlda text record has to break in the same place as before.
+# tags*.ol  - every tag type, including values that truncate and bad
+#             branch offsets (those draw the expected warnings/errors).
+# fold.ol   - references to a group, to segments, to an undefined
+#             symbol and to an unresolved one, with constants added.
+#             None of them may be folded before the link is located.
+# The .hex links are also done with -threads=3 so pass 2 lays out
+# the runs on workers, falling back for the runs that draw messages.
+# cross*.ol - symbols referenced from several files, one of them linked
+#             twice and one naming a symbol twice, for the -cross map.
+# fit.ol    - five segments FIT packed around a RESERVE. fit.opt has
+#             room for them all; fitto.opt does not, so two of them
+#             are placed past TO with errors.
+# overlap.ol - two segments located over each other, linked with -image
+#             so the bytes written twice draw a warning.
+# tagsimg.hex, foldimg.hex - the tags and fold links written with -image.
+#             They load the same memory as tags.hex and fold.hex.
+# lbx*.ol   - lbxmain.ol pulls f1 and f2 from a library. An index is
+#             built for lbxa.lib, then the library is replaced by
+#             lbxc.lib (same size and mtime, different f1). The stale
+#             index must not be used.
+# The .map files have their title line (date and version) removed.
+
+LLF=${1:-../llf}
+bad=0
+
+try()
+{
+	exp=$1
+	shift
+	$LLF "$@" -nomap > check.out 2>&1
+	if cmp -s $exp check.tmp
+	then
+		echo "    $exp ok"
+	else
+		echo "    $exp FAILED"
+		bad=1
+	fi
+	rm -f check.tmp check.out
+}
+
+trymap()
+{
+	exp=$1
+	shift
+	$LLF "$@" -map=check.map > check.out 2>&1
+	grep -v " LLF V" check.map > check.tmp
+	if cmp -s $exp check.tmp
+	then
+		echo "    $exp ok"
+	else
+		echo "    $exp FAILED"
+		bad=1
+	fi
+	rm -f check.tmp check.out check.map check.hex
+}
+
+try vrep.vlda vrep.ol -vlda -out=check.tmp
+try tags.vlda tags1.ol tags2.ol -vlda -out=check.tmp
+try tags.hex tags1.ol tags2.ol -out=check.tmp
+try fold.hex fold.ol -opt=fold.opt -out=check.tmp
+try fold.vlda fold.ol -opt=fold.opt -vlda -out=check.tmp
+try tags.hex tags1.ol tags2.ol -threads=3 -out=check.tmp
+try fold.hex fold.ol -opt=fold.opt -threads=3 -out=check.tmp
+trymap cross.map cross1.ol cross2.ol cross3.ol cross2.ol -cross -out=check.hex
+try fit.hex fit.ol -opt=fit.opt -out=check.tmp
+trymap fit.map fit.ol -opt=fit.opt -out=check.hex
+trymap fitto.map fit.ol -opt=fitto.opt -out=check.hex
+try tagsimg.hex tags1.ol tags2.ol -image -out=check.tmp
+try tagsimg.hex tags1.ol tags2.ol -image -threads=3 -out=check.tmp
+try foldimg.hex fold.ol -opt=fold.opt -image -out=check.tmp
+trymap overlap.map overlap.ol -opt=overlap.opt -image -out=check.hex
+cp lbxa.lib check.lib
+touch -t 202001010000 check.lib
+try lbxa.hex lbxmain.ol -lib=check.lib -index -out=check.tmp
+if [ ! -f check.lbx ]
+then
+	echo "    check.lbx not built"
+	bad=1
+fi
+try lbxa.hex lbxmain.ol -lib=check.lib -out=check.tmp
+cp lbxc.lib check.lib
+touch -t 202001010000 check.lib
+try lbxc.hex lbxmain.ol -lib=check.lib -out=check.tmp
+rm -f check.lib check.lbx
+exit $bad
@@ -113,8 +113,8 @@ void display_mem( void )
     sprintf(s,"%ld\n\txref stuff:\t%ld\n\tgroup stuff:\t%ld\n\tsym stuff:\t%ld",
             fn_pool_used,xref_pool_used,grp_pool_used,sym_pool_used);
     s += strlen(s);
-    sprintf(s,"\n\ttmp file:\t%ld\n\tsymd file:\t%ld\n\tmisc stuff:\t%ld",
-            tmp_pool_used,symdef_pool_used,misc_pool_used+rm_pool_used);
+    sprintf(s,"\n\ttmp file:\t%ld\n\ttmp spilled:\t%ld\n\tsymd file:\t%ld\n\tmisc stuff:\t%ld",
+            tmp_pool_used,tmp_spill_used,symdef_pool_used,misc_pool_used+rm_pool_used);
     s += strlen(s);
     sprintf(s,"\n\tID table:\t%ld\n\ttotal used:\t%ld\tpeak used:\t%ld\n",
             id_table_size*sizeof(struct ss_struct *),total_mem_used,peak_mem_used);
@@ -32,9 +32,10 @@ enum token {
 	MAX_TOKEN 	=2048,		/* maximum length for token strings and input string */
 	MAX_LINE  	=264,		/* maximum length for output line */
 	
-	HASH_TABLE_SIZE =3001,	/* hash table size (prime number) */
+	HASH_TABLE_SIZE =4096,	/* initial hash table size (power of 2) */
+	NAME_POOL_SIZE =16384,	/* size of name arena blocks */
 	
-	XREF_BLOCK_SIZE =4,		/* 3 filenames/xref block + link to next */
+	XREF_BLOCK_SIZE =6,		/* file indexes per xref block */
 	
 	TOKEN_cmd      =0,   /* command char follows (char) */
 	TOKEN_ID       =1,   /* ID string follows (s) */
@@ -99,6 +100,7 @@ enum token {
 	OUT_FN_STB,
 	OUT_FN_SYM,
 	OUT_FN_SEC,
+	OUT_FN_JSON,
 	OUT_FN_TMP,
 	OUT_FN_MAX,		/* maximum # of output files */
 	
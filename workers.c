@@ -0,0 +1,152 @@
+/*
+    workers.c - Part of llf, a cross linker. Part of the macxx tool chain.
+    Copyright (C) 2008 David Shepperd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>		/* get standard I/O definitions */
+#include <stdlib.h>
+#include <string.h>
+#if defined(M_UNIX)
+	#include <unistd.h>
+	#include <pthread.h>
+#endif
+#include "token.h"		/* define compile time constants */
+#include "structs.h"		/* define structures */
+#include "header.h"
+
+/*
+ * Worker threads for jobs that can be split into independent pieces.
+ *
+ * The caller cuts its work into numbered jobs whose results land in
+ * places of their own (a buffer per job, say), calls wrk_run(), and
+ * then does whatever has to happen in order (writing to a file,
+ * reporting errors) itself once wrk_run() returns. The jobs must not
+ * touch llf's globals other than to read them.
+ *
+ * -THREADS=n sets how many threads share the jobs; the default is the
+ * number of processors online, up to WRK_MAX. -THREADS=1, or a build
+ * without M_UNIX, runs the jobs one after the other in the caller.
+ */
+
+#define WRK_MAX		8	/* most threads used unless -THREADS says */
+
+/**************************************************************************
+ * wrk_count - number of threads to share jobs among
+ */
+int wrk_count( void )
+/*
+ * At entry:
+ *	no requirements
+ * At exit:
+ *	returns 1 or more
+ */
+{
+    static int count;
+
+    if (!count)
+    {
+        count = 1;
+#if defined(M_UNIX)
+        if (qual_tbl[QUAL_THREADS].present)
+        {
+            count = qual_tbl[QUAL_THREADS].valueInt;
+        }
+        else
+        {
+            long cpus;
+            cpus = sysconf(_SC_NPROCESSORS_ONLN);
+            if (cpus > WRK_MAX) cpus = WRK_MAX;
+            if (cpus > 1) count = cpus;
+        }
+        if (count < 1) count = 1;
+#endif
+    }
+    return count;
+}
+
+#if defined(M_UNIX)
+
+typedef struct wrk_ctl
+{
+    void (*wc_job)(void *arg, int job);	/* function to call */
+    void *wc_arg;			/* argument to pass it */
+    int wc_next;			/* next job to hand out */
+    int wc_jobs;			/* number of jobs */
+    pthread_mutex_t wc_lock;
+} WrkCtl_t;
+
+static void *wrk_thread(void *arg)
+{
+    WrkCtl_t *wc = (WrkCtl_t *)arg;
+    int job;
+
+    while (1)
+    {
+        pthread_mutex_lock(&wc->wc_lock);
+        job = wc->wc_next;
+        if (job < wc->wc_jobs) ++wc->wc_next;
+        pthread_mutex_unlock(&wc->wc_lock);
+        if (job >= wc->wc_jobs) break;
+        wc->wc_job(wc->wc_arg,job);
+    }
+    return 0;
+}
+#endif
+
+/**************************************************************************
+ * wrk_run - call a function once for each of a number of jobs
+ */
+void wrk_run( int jobs, void (*job)(void *arg, int job), void *arg )
+/*
+ * At entry:
+ *	jobs - number of jobs
+ *	job - function to call with arg and each job number 0..jobs-1
+ *	arg - passed to job
+ * At exit:
+ *	all jobs have been done, in no particular order. The calling
+ *	thread does some of them itself.
+ */
+{
+    int ii,nthr;
+#if defined(M_UNIX)
+    WrkCtl_t wc;
+    pthread_t thr[WRK_MAX*4];
+#endif
+
+    nthr = wrk_count();
+    if (nthr > jobs) nthr = jobs;
+#if defined(M_UNIX)
+    if (nthr > 1)
+    {
+        int started;
+        if (nthr > WRK_MAX*4) nthr = WRK_MAX*4;
+        wc.wc_job = job;
+        wc.wc_arg = arg;
+        wc.wc_next = 0;
+        wc.wc_jobs = jobs;
+        pthread_mutex_init(&wc.wc_lock,0);
+        for (started=0; started < nthr-1; ++started)
+        {
+            if (pthread_create(thr+started,0,wrk_thread,&wc)) break;
+        }
+        wrk_thread(&wc);        /* help out, and pick up the rest if create failed */
+        for (ii=0; ii < started; ++ii) pthread_join(thr[ii],0);
+        pthread_mutex_destroy(&wc.wc_lock);
+        return;
+    }
+#endif
+    for (ii=0; ii < jobs; ++ii) job(arg,ii);
+}
@@ -0,0 +1,300 @@
+/*
+    writer.c - Part of llf, a cross linker. Part of the macxx tool chain.
+    Copyright (C) 2008 David Shepperd
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#if defined(M_UNIX) && !defined(_GNU_SOURCE)
+	#define _GNU_SOURCE		/* for fopencookie() */
+#endif
+#include <stdio.h>		/* get standard I/O definitions */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#if defined(M_UNIX)
+	#include <sys/types.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <pthread.h>
+#endif
+#include "token.h"		/* define compile time constants */
+#include "structs.h"		/* define structures */
+#include "header.h"
+
+/*
+ * Background writers for -ASYNC.
+ *
+ * The map, symbol, section and .stb files are not read back by anything
+ * llf does later, so with -ASYNC each of them is opened as a stdio
+ * stream whose buffer, each time it fills, is copied into one of a
+ * few queue slots and handed to a thread of its own to write to the
+ * file. Formatting carries on while the writes are done. When the
+ * queue is full the main thread waits for a slot to empty.
+ *
+ * Closing the stream only marks the end of its queue, so a file closed
+ * before pass 2 is written out while pass 2 runs. wrt_finish() waits
+ * for the writers that have been closed and reports any write errors.
+ * Without M_UNIX, or without -ASYNC, wrt_open() is just fopen().
+ */
+
+#if defined(M_UNIX)
+
+#define WRT_SLOTS	4	/* filled buffers that may be waiting */
+
+typedef struct wrt_file
+{
+	struct wrt_file *wf_next;	/* next writer */
+	FILE *wf_fp;		/* stream while open, 0 once closed */
+	char *wf_name;		/* name of file for messages */
+	int wf_fd;		/* file being written */
+	int wf_err;		/* errno of first failed write */
+	int wf_done;		/* stream has been closed */
+	int wf_head;		/* oldest filled slot */
+	int wf_count;		/* number of filled slots */
+	char *wf_slot[WRT_SLOTS];	/* slot buffers */
+	size_t wf_len[WRT_SLOTS];	/* bytes in each slot */
+	size_t wf_size[WRT_SLOTS];	/* size of each slot buffer */
+	pthread_t wf_thread;
+	pthread_mutex_t wf_lock;
+	pthread_cond_t wf_cond;	/* signalled when a slot fills or empties */
+} WrtFile_t;
+
+static WrtFile_t *wrt_list;
+
+static void *wrt_thread(void *arg)
+{
+	WrtFile_t *wf = (WrtFile_t *)arg;
+	char *buf;
+	size_t len;
+	ssize_t cnt;
+	int err;
+
+	pthread_mutex_lock(&wf->wf_lock);
+	for (;;)
+	{
+		while ( !wf->wf_count && !wf->wf_done )
+			pthread_cond_wait(&wf->wf_cond, &wf->wf_lock);
+		if ( !wf->wf_count )
+			break;
+		buf = wf->wf_slot[wf->wf_head];
+		len = wf->wf_len[wf->wf_head];
+		pthread_mutex_unlock(&wf->wf_lock);
+		err = 0;
+		while ( len > 0 )
+		{
+			cnt = write(wf->wf_fd, buf, len);
+			if ( cnt < 0 )
+			{
+				if ( errno == EINTR )
+					continue;
+				err = errno;
+				break;
+			}
+			buf += cnt;
+			len -= cnt;
+		}
+		pthread_mutex_lock(&wf->wf_lock);
+		if ( err && !wf->wf_err )
+			wf->wf_err = err;
+		wf->wf_head = (wf->wf_head + 1) % WRT_SLOTS;
+		--wf->wf_count;
+		pthread_cond_broadcast(&wf->wf_cond);
+	}
+	pthread_mutex_unlock(&wf->wf_lock);
+	if ( close(wf->wf_fd) < 0 && !wf->wf_err )
+		wf->wf_err = errno;
+	return 0;
+}
+
+static ssize_t wrt_write(void *cookie, const char *buf, size_t len)
+{
+	WrtFile_t *wf = (WrtFile_t *)cookie;
+	int idx;
+
+	pthread_mutex_lock(&wf->wf_lock);
+	while ( wf->wf_count >= WRT_SLOTS && !wf->wf_err )
+		pthread_cond_wait(&wf->wf_cond, &wf->wf_lock);
+	if ( wf->wf_err )
+	{
+		pthread_mutex_unlock(&wf->wf_lock);
+		errno = wf->wf_err;
+		return -1;
+	}
+	idx = (wf->wf_head + wf->wf_count) % WRT_SLOTS;
+	pthread_mutex_unlock(&wf->wf_lock);
+	/* the slot past the filled ones is ours until it is counted */
+	if ( wf->wf_size[idx] < len )
+	{
+		if ( wf->wf_slot[idx] )
+		{
+			MEM_free(wf->wf_slot[idx]);
+			misc_pool_used -= wf->wf_size[idx];
+		}
+		wf->wf_slot[idx] = MEM_alloc(len);
+		wf->wf_size[idx] = len;
+		misc_pool_used += len;
+	}
+	memcpy(wf->wf_slot[idx], buf, len);
+	wf->wf_len[idx] = len;
+	pthread_mutex_lock(&wf->wf_lock);
+	++wf->wf_count;
+	pthread_cond_broadcast(&wf->wf_cond);
+	pthread_mutex_unlock(&wf->wf_lock);
+	return len;
+}
+
+static int wrt_close(void *cookie)
+{
+	WrtFile_t *wf = (WrtFile_t *)cookie;
+
+	pthread_mutex_lock(&wf->wf_lock);
+	wf->wf_done = 1;
+	wf->wf_fp = 0;
+	pthread_cond_broadcast(&wf->wf_cond);
+	pthread_mutex_unlock(&wf->wf_lock);
+	return 0;
+}
+
+/********************************************************************
+ * Close any writers still open at exit
+ */
+static void wrt_exit(void)
+{
+	WrtFile_t *wf;
+
+	for (wf = wrt_list; wf; wf = wf->wf_next)
+	{
+		if ( wf->wf_fp )
+			fclose(wf->wf_fp);
+		pthread_join(wf->wf_thread, 0);
+	}
+}
+#endif	/* M_UNIX */
+
+/********************************************************************
+ * Open an output file that llf only writes
+ */
+FILE *wrt_open(const char *name, const char *mode)
+/*
+ * At entry:
+ *	name - name of file to create
+ *	mode - fopen() mode
+ * At exit:
+ *	returns stream open for writing or 0 with errno set if the file
+ *	could not be created. With -ASYNC the stream's writes are done
+ *	by a thread of its own.
+ */
+{
+#if defined(M_UNIX)
+	static int registered;
+	static cookie_io_functions_t funcs = { 0, wrt_write, 0, wrt_close };
+	WrtFile_t *wf;
+	int fd, err;
+
+	if ( !qual_tbl[QUAL_ASYNC].present )
+		return fopen(name, mode);
+	if ( (fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0 )
+		return 0;
+	wf = (WrtFile_t *)MEM_alloc(sizeof(WrtFile_t));
+	misc_pool_used += sizeof(WrtFile_t);
+	wf->wf_fd = fd;
+	pthread_mutex_init(&wf->wf_lock, 0);
+	pthread_cond_init(&wf->wf_cond, 0);
+	if ( (err = pthread_create(&wf->wf_thread, 0, wrt_thread, wf)) != 0 )
+	{
+		pthread_cond_destroy(&wf->wf_cond);
+		pthread_mutex_destroy(&wf->wf_lock);
+		MEM_free(wf);
+		misc_pool_used -= sizeof(WrtFile_t);
+		sprintf(emsg, "Unable to start writer for \"%s\": %s. Writing it directly.",
+				name, err2str(err));
+		err_msg(MSG_WARN, emsg);
+		close(fd);
+		return fopen(name, mode);
+	}
+	if ( (wf->wf_fp = fopencookie(wf, "w", funcs)) == 0 )
+	{
+		err = errno;
+		wrt_close(wf);
+		pthread_join(wf->wf_thread, 0);
+		pthread_cond_destroy(&wf->wf_cond);
+		pthread_mutex_destroy(&wf->wf_lock);
+		MEM_free(wf);
+		misc_pool_used -= sizeof(WrtFile_t);
+		errno = err;
+		return 0;
+	}
+	wf->wf_name = MEM_alloc(strlen(name) + 1);
+	misc_pool_used += strlen(name) + 1;
+	strcpy(wf->wf_name, name);
+	wf->wf_next = wrt_list;
+	wrt_list = wf;
+	if ( !registered )
+	{
+		atexit(wrt_exit);
+		registered = 1;
+	}
+	return wf->wf_fp;
+#else
+	return fopen(name, mode);
+#endif
+}
+
+/********************************************************************
+ * Wait for the writers of closed files
+ */
+void wrt_finish(void)
+/*
+ * At exit:
+ *	every file closed so far has been completely written and its
+ *	writer is gone. Write errors are reported.
+ */
+{
+#if defined(M_UNIX)
+	WrtFile_t *wf, **prev;
+	int ii;
+
+	prev = &wrt_list;
+	while ( (wf = *prev) != 0 )
+	{
+		if ( !wf->wf_done )
+		{
+			prev = &wf->wf_next;
+			continue;
+		}
+		pthread_join(wf->wf_thread, 0);
+		*prev = wf->wf_next;
+		if ( wf->wf_err )
+		{
+			sprintf(emsg, "Error writing \"%s\": %s", wf->wf_name, err2str(wf->wf_err));
+			err_msg(MSG_ERROR, emsg);
+		}
+		for (ii = 0; ii < WRT_SLOTS; ++ii)
+		{
+			if ( wf->wf_slot[ii] )
+			{
+				MEM_free(wf->wf_slot[ii]);
+				misc_pool_used -= wf->wf_size[ii];
+			}
+		}
+		pthread_cond_destroy(&wf->wf_cond);
+		pthread_mutex_destroy(&wf->wf_lock);
+		misc_pool_used -= strlen(wf->wf_name) + 1;
+		MEM_free(wf->wf_name);
+		MEM_free(wf);
+		misc_pool_used -= sizeof(WrtFile_t);
+	}
+#endif
+}